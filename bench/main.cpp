@@ -0,0 +1,449 @@
+#include <precomp.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <Ctx.h>
+#include <BufferTools.h>
+#include <ImageTools.h>
+#include <Primitives.h>
+#include <GridRender.h>
+#include <Grader.h>
+#include <Lottery.h>
+#include <Evolve.h>
+#include <Reduce.h>
+#include <Refine.h>
+#include <Climb.h>
+#include <Cull.h>
+#include <RenderGraph.h>
+
+// Headless microbenchmarks of every stage and of a full generation over a sweep of
+// population shapes. Usage: cvulkan_bench [--iterations N] [--output results.json]
+
+struct BenchConfig {
+    uint32_t instancesWidth;
+    uint32_t instancesHeight;
+    uint32_t trianglesPerInstance;
+    uint32_t imageWidth;
+    uint32_t imageHeight;
+
+    uint32_t nrInstances() const { return instancesWidth * instancesHeight; }
+    uint32_t nrVertices() const { return 3 * nrInstances() * trianglesPerInstance; }
+    uint64_t gridPixels() const { return uint64_t(instancesWidth * imageWidth) * (instancesHeight * imageHeight); }
+};
+
+struct BenchResult {
+    const char* stage;
+    BenchConfig config;
+    uint32_t iterations;
+    double seconds;
+    // Estimated from the sizes of the resources each stage touches, overdraw is not counted
+    uint64_t pixelsPerIteration;
+    uint64_t bytesPerIteration;
+};
+
+struct BenchStages {
+    Image gridTarget;
+    Image goal;
+    // Host copies for the CPU reference of the refine gradients
+    std::vector<float> goalPixels;
+    std::vector<Vertex> genomes;
+    Buffer vertexBuffers[2];
+    Buffer scoresBuffer;
+    Buffer parentsBuffer;
+    GridRender gridRender;
+    GridRender gridRenderInstanced;
+    // Draws what the cull kept
+    GridRender gridRenderCulled;
+    Grader grader;
+    Lottery lottery;
+    Evolve evolve;
+    // Over the floats of the genomes, as one segment
+    Reduce reduce;
+    Reduce scan;
+    // A single step per run, on the first instance while the scores are equal
+    Refine refine;
+    Climb climb;
+    Buffer culledVertices;
+    Buffer culledDraws;
+    Cull cull;
+    RenderGraph graph;
+};
+
+// Largest error of the refine gradients relative to the largest CPU reference gradient,
+// the float atomics of the GPU sum in another order
+constexpr float refineCheckTolerance = 1e-3f;
+
+BenchStages createStages(Ctx& ctx, const BenchConfig& config);
+void destroyStages(Ctx& ctx, BenchStages& stages);
+BenchResult measure(Ctx& ctx, const char* stage, const BenchConfig& config, uint32_t iterations,
+        uint64_t pixels, uint64_t bytes, const std::function<void()>& record);
+void writeJson(std::ostream& out, const char* device, const std::vector<BenchResult>& results);
+// Quoted, with the characters JSON does not allow in a string escaped
+std::string jsonString(std::string_view value);
+
+int main(int argc, char** argv) {
+    logger::set_level(spdlog::level::warn);
+
+    uint32_t iterations = 50;
+    const char* outputPath = nullptr;
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i+1 < argc) {
+            iterations = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--output") == 0 && i+1 < argc) {
+            outputPath = argv[++i];
+        } else {
+            logger::crash(fmt::format("usage: {} [--iterations N] [--output results.json]", argv[0]));
+        }
+    }
+
+    CtxInfo info {
+        .instanceExtensions = {},
+        .deviceExtensions = {VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME},
+        .pipelineCachePath = nullptr,
+        .headless = true,
+    };
+    Ctx ctx = ctxCreate(info);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &properties);
+
+    std::vector<BenchConfig> sweep;
+    for (auto [imageWidth, imageHeight] : { std::pair{128u, 160u}, std::pair{256u, 320u} }) {
+        for (uint32_t instances : { 2u, 4u, 6u }) {
+            for (uint32_t triangles : { 50u, 100u, 200u }) {
+                sweep.push_back({ instances, instances, triangles, imageWidth, imageHeight });
+            }
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (const auto& config : sweep) {
+        auto stages = createStages(ctx, config);
+
+        const uint64_t gridBytes = config.gridPixels() * 4 * sizeof(float);
+        const uint64_t vertexBytes = config.nrVertices() * sizeof(Vertex);
+        const uint64_t scoreBytes = config.nrInstances() * sizeof(float);
+        const uint64_t parentBytes = config.nrInstances() * 2 * sizeof(uint32_t);
+
+        const uint64_t renderBytes = vertexBytes + gridBytes;
+        // grid image and goal
+        const uint64_t graderBytes = 2 * gridBytes + scoreBytes;
+        // scores read and reset, parents written
+        const uint64_t lotteryBytes = 2 * scoreBytes + parentBytes;
+        // two parents read, one child written
+        const uint64_t evolveBytes = 3 * vertexBytes + parentBytes;
+        // goal read, genome, gradients and both moments read and written
+        const uint64_t refineBytes = uint64_t(config.imageWidth) * config.imageHeight * 4 * sizeof(float)
+                + 8 * 3 * config.trianglesPerInstance * sizeof(Vertex);
+
+        // Every iteration goes through the graph, so back to back runs get the barriers they need
+        auto& graph = stages.graph;
+        auto renderPerVertex = [&]() { gridRenderAddPass(ctx, graph, stages.gridRender); renderGraphExecute(ctx, graph); };
+        auto render = [&]() { gridRenderAddPass(ctx, graph, stages.gridRenderInstanced); renderGraphExecute(ctx, graph); };
+        auto grade = [&]() { graderAddPass(ctx, graph, stages.grader, { .runSeed = 1, .generation = 0 }); renderGraphExecute(ctx, graph); };
+        // The stride a stochastic run starts out with
+        const uint32_t sampleStride = graderScheduleStride(stages.grader.info, 0.0f);
+        auto gradeSampled = [&]() {
+            graderAddPass(ctx, graph, stages.grader, { .runSeed = 1, .generation = 0, .sampleStride = sampleStride });
+            renderGraphExecute(ctx, graph);
+        };
+        auto lottery = [&]() { lotteryAddPass(ctx, graph, stages.lottery, { .runSeed = 1, .generation = 0 }); renderGraphExecute(ctx, graph); };
+        auto evolve = [&]() { evolveAddPass(ctx, graph, stages.evolve, { .runSeed = 1, .generation = 0 }); renderGraphExecute(ctx, graph); };
+        auto generation = [&]() { render(); grade(); lottery(); evolve(); };
+        auto reduce = [&]() { reduceAddPass(ctx, graph, stages.reduce); renderGraphExecute(ctx, graph); };
+        auto scan = [&]() { reduceAddPass(ctx, graph, stages.scan); renderGraphExecute(ctx, graph); };
+        auto refine = [&]() { refineAddPasses(ctx, graph, stages.refine); renderGraphExecute(ctx, graph); };
+        auto climb = [&]() { climbAddPass(ctx, graph, stages.climb, { .runSeed = 1, .generation = 0 }); renderGraphExecute(ctx, graph); };
+        auto cull = [&]() { cullAddPass(ctx, graph, stages.cull); renderGraphExecute(ctx, graph); };
+        auto renderCulled = [&]() {
+            cullAddPass(ctx, graph, stages.cull);
+            gridRenderAddPass(ctx, graph, stages.gridRenderCulled);
+            renderGraphExecute(ctx, graph);
+        };
+
+        // The gradient pass against its CPU reference, before anything changed the genomes
+        measure(ctx, "refine_check", config, 1, 0, 0, refine);
+        auto gradients = refineDownloadGradients(ctx, stages.refine, 0);
+        std::vector<Vertex> reference;
+        refineReferenceGradients(stages.refine.info, stages.genomes.data(), config.trianglesPerInstance,
+                stages.goalPixels.data(), reference);
+        float largest = 0.0f;
+        float error = 0.0f;
+        for (size_t i=0; i<reference.size(); i++) {
+            glm::vec4 difference[] = { gradients[i].pos - reference[i].pos, gradients[i].color - reference[i].color };
+            for (uint32_t c=0; c<4; c++) {
+                largest = std::max({ largest, std::abs(reference[i].pos[c]), std::abs(reference[i].color[c]) });
+                error = std::max({ error, std::abs(difference[0][c]), std::abs(difference[1][c]) });
+            }
+        }
+        const float relativeError = error / std::max(largest, 1e-20f);
+        if (relativeError > refineCheckTolerance) {
+            logger::crash(fmt::format("Refine gradients are {:.2e} off the CPU reference, relative to the largest, tolerance {:.0e}",
+                    relativeError, refineCheckTolerance));
+        }
+        logger::info("Refine gradients within {:.2e} of the CPU reference, relative to the largest", relativeError);
+
+        // Warm up caches and lazily created driver state
+        measure(ctx, "warmup", config, 1, 0, 0, generation);
+
+        results.push_back(measure(ctx, "grid_render", config, iterations, config.gridPixels(), renderBytes, renderPerVertex));
+        results.push_back(measure(ctx, "grid_render_instanced", config, iterations, config.gridPixels(), renderBytes, render));
+        results.push_back(measure(ctx, "grader", config, iterations, config.gridPixels(), graderBytes, grade));
+        results.push_back(measure(ctx, "grader_sampled", config, iterations, config.gridPixels() / sampleStride,
+                    graderBytes / sampleStride, gradeSampled));
+        results.push_back(measure(ctx, "lottery", config, iterations, 0, lotteryBytes, lottery));
+        results.push_back(measure(ctx, "evolve", config, iterations, 0, evolveBytes, evolve));
+        results.push_back(measure(ctx, "reduce", config, iterations, 0, vertexBytes, reduce));
+        // input read and output written, then read and written again by the add pass
+        results.push_back(measure(ctx, "scan", config, iterations, 0, 4 * vertexBytes, scan));
+        results.push_back(measure(ctx, "refine", config, iterations, uint64_t(config.imageWidth) * config.imageHeight,
+                    refineBytes, refine));
+        // the genomes are copied like evolve does, the regions graded depend on the mutations
+        results.push_back(measure(ctx, "climb", config, iterations, 0, 2 * vertexBytes + scoreBytes, climb));
+        results.push_back(measure(ctx, "cull", config, iterations, 0, 2 * vertexBytes, cull));
+        results.push_back(measure(ctx, "grid_render_culled", config, iterations, config.gridPixels(), 2 * vertexBytes + renderBytes, renderCulled));
+        results.push_back(measure(ctx, "generation", config, iterations, config.gridPixels(),
+                    renderBytes + graderBytes + lotteryBytes + evolveBytes, generation));
+
+        const auto& gen = results.back();
+        logger::warn("{}x{} instances, {} triangles, {}x{} pixels: {:.1f} generations/s",
+                config.instancesWidth, config.instancesHeight, config.trianglesPerInstance,
+                config.imageWidth, config.imageHeight, gen.iterations / gen.seconds);
+
+        destroyStages(ctx, stages);
+    }
+
+    if (outputPath) {
+        std::ofstream out(outputPath);
+        writeJson(out, properties.deviceName, results);
+    } else {
+        writeJson(std::cout, properties.deviceName, results);
+    }
+
+    ctxFinish(ctx);
+    ctxDestroy(ctx);
+    return 0;
+}
+
+BenchStages createStages(Ctx& ctx, const BenchConfig& config) {
+    BenchStages stages{};
+
+    stages.gridTarget = createImageArrayD(
+            ctx, config.instancesWidth * config.imageWidth, config.instancesHeight * config.imageHeight, 1,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+            VK_FORMAT_R32G32B32A32_SFLOAT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+
+    // A smooth synthetic goal, the content does not matter for throughput
+    auto& pixels = stages.goalPixels;
+    pixels.resize(config.imageWidth * config.imageHeight * 4);
+    for (uint32_t y=0; y<config.imageHeight; y++) {
+        for (uint32_t x=0; x<config.imageWidth; x++) {
+            float* p = &pixels[4 * (y * config.imageWidth + x)];
+            p[0] = x / float(config.imageWidth);
+            p[1] = y / float(config.imageHeight);
+            p[2] = 0.5f;
+            p[3] = 1.0f;
+        }
+    }
+    stages.goal = createImageArrayD(ctx, config.imageWidth, config.imageHeight, 1,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_LAYOUT_GENERAL);
+    uploadImageLayerD(ctx, stages.goal, 0, VK_IMAGE_LAYOUT_GENERAL, pixels.data());
+
+    stages.genomes = randomGenomes(1, 0, 0, config.nrInstances(), config.trianglesPerInstance);
+    for (auto& buffer : stages.vertexBuffers) {
+        buffer = buffertools::createBufferD_Data(ctx,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            stages.genomes.size() * sizeof(Vertex), stages.genomes.data());
+    }
+
+    std::vector<float> scores(config.nrInstances(), 1.0f);
+    std::vector<uint32_t> parents(config.nrInstances()*2, 0);
+    stages.scoresBuffer = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            scores.size() * sizeof(float), scores.data());
+    stages.parentsBuffer = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            parents.size() * sizeof(uint32_t), parents.data());
+
+    GridRenderInfo gridRenderInfo {
+        .buffers = { &stages.vertexBuffers[0], &stages.vertexBuffers[1] },
+        .target = stages.gridTarget,
+        .nrTriangles = config.nrVertices() / 3,
+        .nrInstancesWidth = config.instancesWidth,
+        .nrInstancesHeight = config.instancesHeight,
+    };
+    stages.gridRender = gridRenderCreate(ctx, gridRenderInfo);
+    gridRenderInfo.instanced = true;
+    stages.gridRenderInstanced = gridRenderCreate(ctx, gridRenderInfo);
+
+    GraderInfo graderInfo {
+        .gridImage = &stages.gridTarget,
+        .goal = &stages.goal,
+        .scoreBuffer = &stages.scoresBuffer,
+        .nrInstancesWidth = config.instancesWidth,
+        .nrInstancesHeight = config.instancesHeight,
+        .instanceWidth = config.imageWidth,
+        .instanceHeight = config.imageHeight,
+        .nrInstancesPerGoal = config.nrInstances(),
+    };
+    stages.grader = graderCreate(ctx, graderInfo);
+
+    LotteryInfo lotteryInfo {
+        .scoreBuffer = &stages.scoresBuffer,
+        .parentBuffer = &stages.parentsBuffer,
+        .nrInstances = config.nrInstances(),
+        .nrInstancesPerGroup = config.nrInstances(),
+    };
+    stages.lottery = lotteryCreate(ctx, lotteryInfo);
+
+    EvolveInfo evolveInfo {
+        .vertexBuffers = { &stages.vertexBuffers[0], &stages.vertexBuffers[1] },
+        .parentBuffer = &stages.parentsBuffer,
+        .nrVertices = config.nrVertices(),
+        .nrTrianglesPerInstance = config.trianglesPerInstance,
+    };
+    stages.evolve = evolveCreate(ctx, evolveInfo);
+
+    ReduceInfo reduceInfo {
+        .mode = REDUCE_MODE_REDUCE,
+        .op = REDUCE_OP_ADD,
+        .type = REDUCE_TYPE_FLOAT,
+        .input = &stages.vertexBuffers[0],
+        .segmentSize = static_cast<uint32_t>(config.nrVertices() * sizeof(Vertex) / sizeof(float)),
+    };
+    stages.reduce = reduceCreate(ctx, reduceInfo);
+    reduceInfo.mode = REDUCE_MODE_INCLUSIVE_SCAN;
+    stages.scan = reduceCreate(ctx, reduceInfo);
+
+    RefineInfo refineInfo {
+        .vertexBuffers = { &stages.vertexBuffers[0], &stages.vertexBuffers[1] },
+        .scoreBuffer = &stages.scoresBuffer,
+        .goal = &stages.goal,
+        .nrInstances = config.nrInstances(),
+        .nrInstancesPerGoal = config.nrInstances(),
+        .nrTrianglesPerInstance = config.trianglesPerInstance,
+        .instanceWidth = config.imageWidth,
+        .instanceHeight = config.imageHeight,
+        .steps = 1,
+    };
+    stages.refine = refineCreate(ctx, refineInfo);
+
+    ClimbInfo climbInfo {
+        .vertexBuffers = { &stages.vertexBuffers[0], &stages.vertexBuffers[1] },
+        .scoreBuffer = &stages.scoresBuffer,
+        .goal = &stages.goal,
+        .nrInstances = config.nrInstances(),
+        .nrInstancesPerGoal = config.nrInstances(),
+        .nrTrianglesPerInstance = config.trianglesPerInstance,
+        .instanceWidth = config.imageWidth,
+        .instanceHeight = config.imageHeight,
+    };
+    stages.climb = climbCreate(ctx, climbInfo);
+
+    stages.culledVertices = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            config.nrVertices() * sizeof(Vertex));
+    stages.culledDraws = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            config.nrInstances() * sizeof(VkDrawIndirectCommand));
+    CullInfo cullInfo {
+        .vertexBuffers = { &stages.vertexBuffers[0], &stages.vertexBuffers[1] },
+        .culledVertices = &stages.culledVertices,
+        .culledDraws = &stages.culledDraws,
+        .nrInstances = config.nrInstances(),
+        .nrTrianglesPerInstance = config.trianglesPerInstance,
+        .instanceWidth = config.imageWidth,
+        .instanceHeight = config.imageHeight,
+    };
+    stages.cull = cullCreate(ctx, cullInfo);
+    gridRenderInfo.buffers[0] = gridRenderInfo.buffers[1] = &stages.culledVertices;
+    gridRenderInfo.drawBuffers[0] = gridRenderInfo.drawBuffers[1] = &stages.culledDraws;
+    stages.gridRenderCulled = gridRenderCreate(ctx, gridRenderInfo);
+
+    renderGraphImportImage(stages.graph, stages.gridTarget, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    renderGraphImportImage(stages.graph, stages.goal, VK_IMAGE_LAYOUT_GENERAL);
+    // Keeps the setup uploads out of the first measurement
+    uploaderWait(ctx, ctx.uploader, uploaderFlush(ctx, ctx.uploader));
+    return stages;
+}
+
+void destroyStages(Ctx& ctx, BenchStages& stages) {
+    vkCheck(vkDeviceWaitIdle(ctx.device));
+    evolveDestroy(ctx, stages.evolve);
+    reduceDestroy(ctx, stages.reduce);
+    reduceDestroy(ctx, stages.scan);
+    refineDestroy(ctx, stages.refine);
+    climbDestroy(ctx, stages.climb);
+    cullDestroy(ctx, stages.cull);
+    gridRenderDestroy(ctx, stages.gridRenderCulled);
+    buffertools::destroyBuffer(ctx, stages.culledVertices);
+    buffertools::destroyBuffer(ctx, stages.culledDraws);
+    lotteryDestroy(ctx, stages.lottery);
+    graderDestroy(ctx, stages.grader);
+    gridRenderDestroy(ctx, stages.gridRender);
+    gridRenderDestroy(ctx, stages.gridRenderInstanced);
+    for (auto& buffer : stages.vertexBuffers) {
+        buffertools::destroyBuffer(ctx, buffer);
+    }
+    buffertools::destroyBuffer(ctx, stages.scoresBuffer);
+    buffertools::destroyBuffer(ctx, stages.parentsBuffer);
+    destroyImage(ctx, stages.gridTarget);
+    destroyImage(ctx, stages.goal);
+    // The descriptor sets of this config are no longer used
+    vkCheck(vkResetDescriptorPool(ctx.device, ctx.descriptorPool, 0));
+}
+
+BenchResult measure(Ctx& ctx, const char* stage, const BenchConfig& config, uint32_t iterations,
+        uint64_t pixels, uint64_t bytes, const std::function<void()>& record) {
+    auto frame = ctxBeginFrame(ctx);
+    auto beginInfo = vks::initializers::commandBufferBeginInfo();
+    vkCheck(vkBeginCommandBuffer(frame.cmdBuffer, &beginInfo));
+    for (uint32_t i=0; i<iterations; i++) {
+        record();
+    }
+    vkCheck(vkEndCommandBuffer(frame.cmdBuffer));
+
+    auto start = std::chrono::steady_clock::now();
+    ctxEndFrame(ctx, frame.cmdBuffer);
+    vkCheck(vkWaitForFences(ctx.device, 1, &ctx.inFlightFence, VK_TRUE, UINT64_MAX));
+    auto end = std::chrono::steady_clock::now();
+
+    return BenchResult {
+        .stage = stage,
+        .config = config,
+        .iterations = iterations,
+        .seconds = std::chrono::duration<double>(end - start).count(),
+        .pixelsPerIteration = pixels,
+        .bytesPerIteration = bytes,
+    };
+}
+
+void writeJson(std::ostream& out, const char* device, const std::vector<BenchResult>& results) {
+    out << "{\n  \"device\": " << jsonString(device) << ",\n  \"results\": [\n";
+    for (size_t i=0; i<results.size(); i++) {
+        const auto& r = results[i];
+        out << fmt::format(
+                "    {{\"stage\": {}, \"instancesWidth\": {}, \"instancesHeight\": {}, \"trianglesPerInstance\": {}, "
+                "\"imageWidth\": {}, \"imageHeight\": {}, \"iterations\": {}, \"seconds\": {:.6f}, "
+                "\"generationsPerSec\": {:.3f}, \"pixelsPerSec\": {:.1f}, \"bytesPerIteration\": {}, \"bytesPerSec\": {:.1f}}}{}\n",
+                jsonString(r.stage), r.config.instancesWidth, r.config.instancesHeight, r.config.trianglesPerInstance,
+                r.config.imageWidth, r.config.imageHeight, r.iterations, r.seconds,
+                r.iterations / r.seconds, r.pixelsPerIteration * r.iterations / r.seconds,
+                r.bytesPerIteration, r.bytesPerIteration * r.iterations / r.seconds,
+                i+1 < results.size() ? "," : "");
+    }
+    out << "  ]\n}\n";
+}
+
+std::string jsonString(std::string_view value) {
+    std::string ret = "\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            ret += '\\';
+            ret += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            ret += fmt::format("\\u{:04x}", static_cast<unsigned char>(c));
+        } else {
+            ret += c;
+        }
+    }
+    return ret + "\"";
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+#include <BufferTools.h>
+#include <ImageTools.h>
+#include <RenderGraph.h>
+#include <Plateau.h>
+#include <Ingest.h>
+
+// Evolves the goal images listed in a manifest (one path per line), nrSlots at a time.
+// Every slot owns nrInstancesPerSlot consecutive instances and one layer of the goal array.
+// A slot moves on to the next goal as soon as the plateau tracker calls its goal done.
+struct BatchInfo {
+    const char* manifestPath;
+    Buffer* vertexBuffers[2];
+    Buffer* scoreBuffer;
+    Image* goals;
+    // Tracks one goal per slot, its passes are added by the owner
+    Plateau* plateau;
+    uint32_t nrSlots;
+    uint32_t nrInstancesPerSlot;
+    uint32_t nrTrianglesPerInstance;
+    // Variable-length genomes, see EvolveInfo. Restarted slots begin with startTriangles.
+    Buffer* drawBuffers[2] = {};
+    uint32_t startTriangles = 0;
+    // See DedupInfo, restarted instances are graded from scratch again
+    Buffer* duplicates = nullptr;
+    // Restarted slots draw their genomes from the counter based generator
+    uint32_t runSeed;
+    // Goal images decoded ahead on worker threads, see IngestInfo
+    uint32_t nrPrefetch = 8;
+};
+
+struct BatchSlot {
+    std::optional<uint32_t> job;
+    uint32_t generation;
+    float bestFitness;
+};
+
+struct Batch {
+    BatchInfo info;
+    std::vector<std::string> manifest;
+    // Decodes the manifest in order, as the slots take on its jobs
+    Ingest ingest;
+    uint32_t nextJob;
+    uint32_t finishedJobs;
+    std::vector<BatchSlot> slots;
+};
+
+Batch batchCreate(Ctx& ctx, BatchInfo& info);
+void batchDestroy(Ctx& ctx, Batch& batch);
+// Call right after ctxBeginFrame with the plateauPoll of this frame, returns false once every
+// job in the manifest is done
+bool batchUpdate(Ctx& ctx, Batch& batch, const std::vector<PlateauState>& states);
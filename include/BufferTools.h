@@ -2,17 +2,20 @@
 #include <precomp.h>
 #include <Ctx.h>
 
-struct Buffer {
-    VkBuffer buffer;
-    VmaAllocation memory;
-};
-
 namespace buffertools {
     Buffer createBufferH2D(Ctx& ctx, VkBufferUsageFlags usage, size_t size);
     Buffer createBufferH2D_Data(Ctx& ctx, VkBufferUsageFlags usage, size_t size, void* data);
     Buffer createBufferD(Ctx& ctx, VkBufferUsageFlags usage, size_t size);
+    // The copy is staged through ctx.uploader and done before the next frame runs
     Buffer createBufferD_Data(Ctx& ctx, VkBufferUsageFlags usage, size_t size, void* data);
     Buffer createBufferH(Ctx& ctx, VkBufferUsageFlags usage, size_t size);
     Buffer createBufferH_Data(Ctx& ctx, VkBufferUsageFlags usage, size_t size, void* data);
+    // Does not block, see createBufferD_Data
+    void uploadBufferD(Ctx& ctx, Buffer& dst, size_t offset, size_t size, void* data);
+    void downloadBufferD(Ctx& ctx, Buffer& src, size_t offset, size_t size, void* data);
     void destroyBuffer(Ctx& ctx, Buffer& buffer);
+    // For buffers whose lifetimes within a frame never overlap: they share one allocation
+    // of the transient pool, all bound at offset 0. Free them with destroyAliasedBuffers.
+    std::vector<Buffer> createAliasedBuffersD(Ctx& ctx, const std::vector<std::pair<VkBufferUsageFlags, size_t>>& buffers);
+    void destroyAliasedBuffers(Ctx& ctx, std::vector<Buffer>& buffers);
 }
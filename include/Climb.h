@@ -0,0 +1,49 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+
+// Instead of the lottery and evolve, every instance runs its own (1+lambda) hill climb or
+// simulated annealing. Each generation proposes nrCandidates single triangle mutations per
+// instance, grades them on the pixels they can change only, and copies the genome from one
+// vertex buffer into the other with the accepted one applied.
+// Fixed length genomes only, the scores have to be graded in full once before the first climb.
+struct ClimbInfo {
+    Buffer* vertexBuffers[2];
+    // Kept up to date with the score difference of the accepted mutations
+    Buffer* scoreBuffer;
+    Image* goal;
+    uint32_t nrInstances;
+    uint32_t nrInstancesPerGoal;
+    uint32_t nrTrianglesPerInstance;
+    // Both multiples of 16
+    uint32_t instanceWidth;
+    uint32_t instanceHeight;
+    // lambda, the best candidate of an instance competes with the genome as is
+    uint32_t nrCandidates = 4;
+};
+
+struct ClimbArgs {
+    uint32_t runSeed;
+    uint32_t generation;
+    // Worse candidates are taken with exp(delta / temperature), 0 is a pure hill climb
+    float temperature = 0.0f;
+};
+
+struct Climb {
+    ClimbInfo info;
+    // propose, grade, decide and apply, see climb.comp
+    CompPipeline pipelines[4];
+    // Set i is used by the frames that climb from vertexBuffers[i] into the other one
+    VkDescriptorSet descriptorSets[4][2];
+    Buffer candidates;
+    Buffer proposals;
+    Buffer tilePartials;
+    Buffer chosen;
+};
+
+Climb climbCreate(Ctx& ctx, ClimbInfo& info);
+void climbDestroy(Ctx& ctx, Climb& climb);
+void climbRecord(Ctx& ctx, Climb& climb, ClimbArgs& args);
+void climbAddPass(Ctx& ctx, RenderGraph& graph, Climb& climb, ClimbArgs args);
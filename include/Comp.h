@@ -6,9 +6,11 @@ typedef std::unordered_map<uint32_t, void*> CompResourceBindings;
 
 
 struct CompInfo {
-    const char* compShaderPath;
+    const char* compShader;
     std::unordered_map<uint32_t, VkDescriptorType> bindingDescription;
     VkPushConstantRange* pushConstantRange;
+    // constant_id i is specialized to specializationConstants[i]
+    std::vector<uint32_t> specializationConstants;
 };
 
 struct CompPipeline {
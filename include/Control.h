@@ -0,0 +1,83 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+#include <Sockets.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+// Names accepted by "set", the owner maps them onto its args
+constexpr std::array<const char*, 6> controlParameters {
+    "shift", "mutation-rate", "adapt-rate", "grow-rate", "shrink-rate", "temperature",
+};
+
+struct ControlInfo {
+    SocketEndpoint endpoint;
+    Buffer* vertexBuffers[2];
+    // Active triangles per instance, only with variable length genomes
+    Buffer* drawBuffers[2] = {};
+    // Indexed mesh genomes, see EvolveInfo, checkpoints write out their triangles
+    Buffer* indexBuffers[2] = {};
+    uint32_t meshVertices = 0;
+    uint32_t nrInstances;
+    uint32_t nrTrianglesPerInstance;
+    // Decoded goal images must match it, nullptr refuses the goal command
+    Image* goals = nullptr;
+};
+
+enum ControlCommandType {
+    CONTROL_SET,
+    CONTROL_GOAL,
+    CONTROL_PAUSE,
+    CONTROL_RESUME,
+};
+
+struct ControlCommand {
+    ControlCommandType type;
+    // Parameter of set or path of goal
+    std::string name;
+    float value;
+    uint32_t layer;
+    // rgba floats of the goal, decoded on the control thread
+    std::vector<float> pixels;
+};
+
+// Filled by the control thread, drained by the evolution loop
+struct ControlQueue {
+    std::atomic<bool> running;
+    std::thread thread;
+    int listenSocket;
+    std::mutex mutex;
+    std::vector<ControlCommand> commands;
+    std::vector<std::string> checkpoints;
+};
+
+// Retunes a running process through one command per line on a localhost port or a unix socket,
+// e.g. echo "set shift 0.9" | nc -U path. Every line is answered with "ok" or "error: why".
+//   set <parameter> <value>    see controlParameters
+//   goal <path> [layer]        replaces a goal image, the population keeps evolving towards it
+//   pause | resume             stops submitting generations, the GPU just goes idle
+//   checkpoint <path>          the genomes of the next generation, one vertex per line like .tri
+// Images are decoded on the control thread, the commands only take effect at the next
+// generation boundary, when controlPoll hands them out.
+struct Control {
+    ControlInfo info;
+    std::unique_ptr<ControlQueue> queue;
+    Buffer genomeReadback;
+    Buffer drawReadback;
+    Buffer indexReadback;
+    // Copied by the frame in flight, written once its fence signalled
+    std::vector<std::string> copiedCheckpoints;
+    uint32_t copiedGeneration;
+};
+
+Control controlCreate(Ctx& ctx, ControlInfo& info);
+// Joins the control thread
+void controlDestroy(Ctx& ctx, Control& control);
+// Call right after ctxBeginFrame. Writes the checkpoints of the last frame and returns the
+// commands received since, the goal uploads are safe to issue from here on.
+std::vector<ControlCommand> controlPoll(Ctx& ctx, Control& control);
+// First thing in the frame, copies the genomes if a checkpoint was asked for
+void controlAddPasses(Ctx& ctx, RenderGraph& graph, Control& control);
@@ -1,12 +1,25 @@
 #pragma once
 #include <precomp.h>
 #include <Types.h>
+#include <Uploader.h>
 
 struct CtxInfo {
     uint32_t windowWidth = 640;
     uint32_t windowHeight = 480;
     std::vector<const char*> instanceExtensions;
     std::vector<const char*> deviceExtensions;
+    // Persistent pipeline cache, nullptr disables it
+    const char* pipelineCachePath = "pipeline_cache.bin";
+    // No window, surface or swapchain; frames are submitted without presenting
+    bool headless = false;
+    // Frames neither acquire nor present, a Presenter shows snapshots from its own thread
+    bool detachedPresent = false;
+    // Falls back to mailbox, immediate and finally FIFO
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    // Persistently mapped host memory all uploads are staged through
+    size_t stagingRingSize = 64 << 20;
+    // Shaders read storage images without a format qualifier, crashes if the device cannot
+    bool storageImageReadWithoutFormat = false;
 };
 
 enum CtxState { 
@@ -21,6 +34,12 @@ struct FrameCtx {
     uint32_t frameIdx = -1;
     Image swapchainImage;
     VkCommandBuffer cmdBuffer;
+    // Extra semaphores of this frame's submit, see ctxFrameWait and ctxFrameSignal
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<VkPipelineStageFlags> waitStages;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkSemaphore> signalSemaphores;
+    std::vector<uint64_t> signalValues;
 };
 
 struct Ctx {
@@ -30,8 +49,15 @@ struct Ctx {
     VkPhysicalDevice physicalDevice;
     VkDevice device;
     VmaAllocator allocator;
+    // Device local pool for transient resources that share memory, see buffertools::createAliasedBuffersD
+    VmaPool transientPool;
+    // VK_EXT_memory_budget is enabled, otherwise the budgets are estimated by VMA
+    bool memoryBudget;
+    // pipelineStatisticsQuery is enabled, see Profiler
+    bool pipelineStatistics;
     VkCommandPool commandPool;
     VkDescriptorPool descriptorPool;
+    VkPipelineCache pipelineCache;
     VkCommandBuffer cmdBuffer;
     struct {
         GLFWwindow* glfwWindow;
@@ -49,12 +75,20 @@ struct Ctx {
         uint32_t graphicsFamily;
         VkQueue present;
         uint32_t presentFamily;
+        // A transfer only family when the device has one, the graphics family otherwise
+        VkQueue transfer;
+        uint32_t transferFamily;
+        // Graphics and transfer family, for resources shared between both
+        std::array<uint32_t, 2> sharedFamilies;
     } queues;
+    Uploader uploader;
 
     VkSemaphore imageAvailable;
     VkSemaphore renderFinished;
     VkFence inFlightFence;
     FrameCtx frameCtx;
+    // VK_KHR_synchronization2, always enabled
+    PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;
 };
 
 
@@ -63,8 +97,32 @@ void ctxDestroy(Ctx&);
 bool ctxWindowShouldClose(Ctx&);
 FrameCtx& ctxBeginFrame(Ctx&);
 void ctxEndFrame(Ctx&, VkCommandBuffer);
+// Adds a semaphore to the submit of the current frame, values are ignored for binary semaphores
+void ctxFrameWait(Ctx& ctx, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stage);
+void ctxFrameSignal(Ctx& ctx, VkSemaphore semaphore, uint64_t value);
+// Serialized, the queues are shared with the uploader and the presenter thread
+void ctxQueueSubmit(const Ctx& ctx, VkQueue queue, const VkSubmitInfo& submitInfo, VkFence fence);
+VkResult ctxQueuePresent(const Ctx& ctx, const VkPresentInfoKHR& presentInfo);
 VkCommandBuffer ctxAllocCmdBuffer(Ctx&);
+// Blocks on the graphics queue, host to device copies go through ctx.uploader instead.
+// Safe to call from multiple threads, the submissions are serialized.
 void ctxSingleTimeCommand(Ctx& ctx, std::function<void(VkCommandBuffer)>);
+// Safe to call from multiple threads, unlike vkAllocateDescriptorSets on the shared pool
+VkDescriptorSet ctxAllocDescriptorSet(const Ctx& ctx, VkDescriptorSetLayout layout);
 void ctxFinish(Ctx&);
+// Logs per heap usage against the budget and the transient pool statistics
+void ctxLogMemoryReport(const Ctx& ctx);
+
+// Device resources the uploader writes are used concurrently by the graphics and transfer families,
+// which saves queue family ownership transfers on devices with a dedicated transfer queue
+template<typename CreateInfo>
+void ctxShareWithTransferQueue(const Ctx& ctx, CreateInfo& createInfo) {
+    if (ctx.queues.transferFamily == ctx.queues.graphicsFamily) {
+        return;
+    }
+    createInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    createInfo.queueFamilyIndexCount = ctx.queues.sharedFamilies.size();
+    createInfo.pQueueFamilyIndices = ctx.queues.sharedFamilies.data();
+}
 
 
@@ -0,0 +1,45 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+
+// Drops the triangles that cannot change the image of their instance before the grid
+// render draws them. The grid render then draws culledVertices through culledDraws.
+// The defaults only drop what leaves the image unchanged, raising minArea or minAlpha
+// trades a little accuracy for fill.
+struct CullInfo {
+    Buffer* vertexBuffers[2];
+    // Active triangles per instance, only with variable length genomes. Their instanceCount is
+    // copied into culledDraws, so the duplicates dedup marked with 0 stay undrawn.
+    Buffer* drawBuffers[2] = {};
+    // Sized like one of the vertex buffers, storage
+    Buffer* culledVertices;
+    // A VkDrawIndirectCommand per instance, storage and indirect
+    Buffer* culledDraws;
+    uint32_t nrInstances;
+    uint32_t nrTrianglesPerInstance;
+    uint32_t instanceWidth;
+    uint32_t instanceHeight;
+    // In pixels
+    float minArea = 0.0f;
+    float minAlpha = 0.0f;
+};
+
+// Push constants of cull.comp
+struct CullArgs {
+    float minArea;
+    float minAlpha;
+};
+
+struct Cull {
+    CullInfo info;
+    CompPipeline pipeline;
+    VkDescriptorSet descriptorSets[2];
+};
+
+Cull cullCreate(Ctx& ctx, CullInfo& info);
+void cullDestroy(Ctx& ctx, Cull& cull);
+void cullRecord(Ctx& ctx, Cull& cull);
+// Right before the grid render
+void cullAddPass(Ctx& ctx, RenderGraph& graph, Cull& cull);
@@ -0,0 +1,50 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+
+// Children that are bit identical to one of their parents, mostly clones of the elite and
+// parents drawn twice, keep the parent's score and are skipped by the render and grade passes.
+struct DedupInfo {
+    Buffer* vertexBuffers[2];
+    // Duplicates are dropped from the draws through their instanceCount
+    Buffer* drawBuffers[2];
+    Buffer* parentBuffer;
+    Buffer* scoreBuffer;
+    // Per instance the parent it duplicates or NO_DUPLICATE, read by the grader.
+    // Has to start out as all NO_DUPLICATE.
+    Buffer* duplicates;
+    uint32_t nrInstances;
+    uint32_t nrTrianglesPerInstance;
+};
+
+// Entry of the duplicates buffer for instances that have to be rendered and graded
+constexpr uint32_t dedupNoDuplicate = 0xFFFFFFFF;
+
+struct Dedup {
+    DedupInfo info;
+    CompPipeline pipeline;
+    VkDescriptorSet descriptorSets[2];
+    // Per instance hash of the genomes in the vertex buffer with the same index
+    Buffer hashes[2];
+    // The scores as graded, before the lottery shifts and resets them
+    Buffer scoreCache;
+    // Duplicates found since the start, wraps around
+    Buffer counter;
+    Buffer counterReadback;
+    uint32_t recorded;
+    uint32_t lastCount;
+    uint32_t lastRecorded;
+};
+
+Dedup dedupCreate(Ctx& ctx, DedupInfo& info);
+void dedupDestroy(Ctx& ctx, Dedup& dedup);
+void dedupRecord(Ctx& ctx, Dedup& dedup);
+// Right after the grader, keeps the scores the children can inherit
+void dedupAddScorePass(Ctx& ctx, RenderGraph& graph, Dedup& dedup);
+// Right after evolve, hashes the children and marks the duplicates among them
+void dedupAddPass(Ctx& ctx, RenderGraph& graph, Dedup& dedup);
+// Share of the children found to be duplicates since the last call.
+// Only call after ctxBeginFrame, before this frame's dedup pass.
+float dedupRatio(Ctx& ctx, Dedup& dedup);
@@ -2,26 +2,56 @@
 #include <precomp.h>
 #include <Comp.h>
 #include <BufferTools.h>
+#include <RenderGraph.h>
 
 struct EvolveInfo {
     Buffer* vertexBuffers[2];
     Buffer* parentBuffer;
+    uint32_t nrVertices;
+    uint32_t nrTrianglesPerInstance;
+    // Per instance VkDrawIndirectCommand, paired with the vertex buffers. Their vertexCount
+    // is the active length of the genome, without them every genome has nrTrianglesPerInstance.
+    Buffer* drawBuffers[2] = {};
+    uint32_t minTriangles = 1;
+    // Per instance EvolveStrategy, paired with the vertex buffers. With them every child
+    // mutates with the rates it inherited instead of EvolveArgs::mutationRate.
+    Buffer* strategyBuffers[2] = {};
+    // Indexed mesh genomes, paired with the vertex buffers, see GridRenderInfo. nrVertices then
+    // counts the pools, children take a range of the pool and of the triangles from each parent.
+    // Neither with drawBuffers nor with strategyBuffers.
+    Buffer* indexBuffers[2] = {};
+    uint32_t meshVertices = 0;
+};
+
+// Self-adaptive mutation parameters of an instance
+struct EvolveStrategy {
+    // Chance per vertex to mutate
+    float mutationRate = 0.001f;
+    // Largest change of a mutated attribute, as a share of its range
+    float mutationStep = 1.0f;
 };
 
 struct Evolve {
+    EvolveInfo info;
     CompPipeline pipeline;
     VkDescriptorSet descriptorSets[2];
 };
 
 struct EvolveArgs {
-    uint32_t nrVertices;
-    uint32_t nrTrianglesPerInstance;
-    uint32_t seed;
+    uint32_t runSeed;
+    uint32_t generation;
+    // Chance per child to gain or lose a triangle, only used with drawBuffers
+    float growRate = 0.0f;
+    float shrinkRate = 0.0f;
+    float mutationRate = 0.001f;
+    // Only used with strategyBuffers
+    float adaptRate = 0.2f;
 };
 
 Evolve evolveCreate(Ctx& ctx, EvolveInfo& info);
 void evolveDestroy(Ctx& ctx, Evolve& evolve);
 void evolveRecord(Ctx& ctx, Evolve& evolve, EvolveArgs& args);
+void evolveAddPass(Ctx& ctx, RenderGraph& graph, Evolve& evolve, EvolveArgs args);
 
 
 
@@ -5,6 +5,31 @@ inline uint32_t g_seed = 1;
 uint32_t rand_xorshift(uint32_t seed);
 float randf(float range = 1.0f);
 
+// Streams of the counter based generator, keep in sync with shaders/common.glsl
+enum RngStream : uint32_t {
+    RNG_STREAM_INIT = 0,
+    RNG_STREAM_LOTTERY = 1,
+    RNG_STREAM_EVOLVE = 2,
+    RNG_STREAM_GRADER = 3,
+    RNG_STREAM_CLIMB = 4,
+};
+
+// Philox4x32-10, bit identical to philox4x32 in shaders/common.glsl
+glm::uvec4 philox4x32(glm::uvec4 counter, glm::uvec2 key);
+
+// The numbers drawn only depend on the constructor arguments, so CPU and GPU
+// can reproduce each other's streams and runs with the same seed match exactly.
+struct CounterRng {
+    glm::uvec2 key;
+    glm::uvec4 counter;
+    glm::uvec4 block;
+    uint32_t idx = 4;
+
+    CounterRng(uint32_t runSeed, uint32_t stream, uint32_t generation, uint32_t instance, uint32_t element);
+    uint32_t randu();
+    float randf(float range = 1.0f);
+};
+
 template<typename T>
 struct RandGen {
     T operator() () const;
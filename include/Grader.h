@@ -2,29 +2,64 @@
 #include <precomp.h>
 #include <Comp.h>
 #include <BufferTools.h>
+#include <RenderGraph.h>
+#include <Reduce.h>
 
 struct GraderInfo {
     Image* gridImage;
     Image* goal;
     Buffer* scoreBuffer;
+    uint32_t nrInstancesWidth;
+    uint32_t nrInstancesHeight;
+    uint32_t instanceWidth;
+    uint32_t instanceHeight;
+    uint32_t nrInstancesPerGoal;
+    // Reduce in a fixed order instead of with float atomics, scores become reproducible
+    bool deterministic = false;
+    // Scratch of the deterministic reduction, graderTilePartialsSize bytes.
+    // Only live during grading so it can alias other transient buffers, created by the grader when null
+    Buffer* tilePartials = nullptr;
+    // Keeps a host copy of the scores for graderBestFitness, which drives the stochastic schedule
+    bool stochastic = false;
+    // Schedule: starts at maxSampleStride and reaches 1 at fullSampleFitness
+    uint32_t maxSampleStride = 10;
+    float fullSampleFitness = 0.9f;
+    // See DedupInfo, duplicates are not graded
+    Buffer* duplicates = nullptr;
+};
+
+struct GraderArgs {
+    uint32_t runSeed;
+    uint32_t generation;
+    // See graderScheduleStride, has to divide instanceHeight / 32
+    uint32_t sampleStride = 1;
 };
 
 struct Grader {
     GraderInfo info;
     CompPipeline pipeline;
     VkDescriptorSet descriptorSet;
+    // One partial sum per 32x32 tile, only used in deterministic mode
+    Buffer tilePartials;
+    CompPipeline resolvePipeline;
+    VkDescriptorSet resolveDescriptorSet;
+    // Best score per goal of the last graded frame, stochastic mode only
+    Reduce bestScores;
+    Buffer scoreReadback;
+    bool hasReadback;
 };
 
-struct GraderArgs {
-    uint32_t nrInstancesWidth;
-    uint32_t nrInstancesHeight;
-    uint32_t instanceWidth;
-    uint32_t instanceHeight;
-};
-
+size_t graderTilePartialsSize(const Image& gridImage);
 Grader graderCreate(Ctx& ctx, GraderInfo& info);
 void graderDestroy(Ctx& ctx, Grader& grader);
 void graderRecord(Ctx& ctx, Grader& grader, GraderArgs& args);
+void graderAddPass(Ctx& ctx, RenderGraph& graph, Grader& grader, GraderArgs args);
+// Sets every score back to 1.0 like the lottery does, for a full grade of scores nothing else resets
+void graderAddResetPass(Ctx& ctx, RenderGraph& graph, Grader& grader);
+// Lowest of the best fitness per goal in the last graded frame, 0 before the first one
+float graderBestFitness(Ctx& ctx, Grader& grader);
+// Largest valid stride on the linear schedule between maxSampleStride and fullSampleFitness
+uint32_t graderScheduleStride(const GraderInfo& info, float fitness);
 
 
 
@@ -5,24 +5,67 @@
 #include <Rast.h>
 #include <BufferTools.h>
 #include <ImageTools.h>
+#include <RenderGraph.h>
 
+// Every layer of the target holds a grid of nrInstancesWidth x nrInstancesHeight
+// instances, so the population is not capped by the maximum framebuffer size.
 struct GridRenderInfo {
     Buffer* buffers[2];
     Image target;
-};
-
-struct GridRenderArgs { 
     uint32_t nrTriangles;
-    uint32_t nrInstanceWidth;
+    uint32_t nrInstancesWidth;
     uint32_t nrInstancesHeight;
+    // One instanced draw per layer, vertices are pulled from the storage buffer
+    // and every instance is clipped to its own cell
+    bool instanced = false;
+    // Variable-length genomes or culled triangles, per instance VkDrawIndirectCommand paired with
+    // the buffers. Only for the instanced path, inactive triangle slots are then never drawn.
+    Buffer* drawBuffers[2] = {};
+    // Indexed mesh genomes, paired with the buffers. Every instance draws 3 * its triangles indices
+    // into its own pool of meshVertices vertices. Only for the instanced path, without drawBuffers.
+    Buffer* indexBuffers[2] = {};
+    uint32_t meshVertices = 0;
+};
+
+// Per instance vertex data of the instanced path
+struct InstanceCell {
+    // x0 y0 x1 y1 of the cell within its layer, normalized
+    glm::vec4 rect;
+
+    static VertexDescription getVertexDescription(uint32_t binding=0) {
+        return {
+            .bindingDescription = {
+                .binding = binding,
+                .stride = sizeof(InstanceCell),
+                .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+            },
+            .attributeDescriptions = {
+                VkVertexInputAttributeDescription {
+                    .location = 0,
+                    .binding = binding,
+                    .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+                    .offset = offsetof(InstanceCell, rect),
+                },
+            },
+        };
+    }
 };
 
 struct GridRender {
     GridRenderInfo info;
     RenderPass renderPass;
     RastPipeline pipeline;
+    // One framebuffer per layer, rendered in separate passes
+    std::vector<VkImageView> layerViews;
+    // Only used by the instanced path
+    Buffer instanceCells;
+    // VkDrawIndexedIndirectCommand per instance, only with indexBuffers
+    Buffer meshDraws;
+    VkDescriptorSetLayout descriptorLayout;
+    VkDescriptorSet descriptorSets[2];
 };
 
 GridRender gridRenderCreate(Ctx& ctx, GridRenderInfo& info);
 void gridRenderDestroy(Ctx& ctx, GridRender& gridRender);
-void grindRenderRecord(Ctx& ctx, GridRender& gridRender, GridRenderArgs& push);
+void grindRenderRecord(Ctx& ctx, GridRender& gridRender);
+void gridRenderAddPass(Ctx& ctx, RenderGraph& graph, GridRender& gridRender);
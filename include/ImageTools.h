@@ -6,4 +6,10 @@
 
 Image createImageD(Ctx& ctx, uint32_t width, uint32_t height, VkImageUsageFlags usage, VkFormat format, VkImageLayout imageLayout);
 Image loadImageD(Ctx& ctx, VkImageLayout initialLayout, const char* filename);
+Image createImageArrayD(Ctx& ctx, uint32_t width, uint32_t height, uint32_t layers, VkImageUsageFlags usage, VkFormat format, VkImageLayout imageLayout);
+Image loadImageArrayD(Ctx& ctx, VkImageLayout layout, const std::vector<const char*>& filenames);
+void uploadImageLayerD(Ctx& ctx, Image& image, uint32_t layer, VkImageLayout layout, const char* filename);
+void uploadImageLayerD(Ctx& ctx, Image& image, uint32_t layer, VkImageLayout layout, const float* pixels);
+// A plain 2D view of a single layer, e.g. to render to or sample one layer of an array
+VkImageView createImageLayerView(Ctx& ctx, const Image& image, uint32_t layer);
 void destroyImage(Ctx& ctx, Image& image);
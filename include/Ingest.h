@@ -0,0 +1,67 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Goal formats that can be ingested, the shaders read them all as normalized floats
+constexpr std::array<VkFormat, 3> ingestFormats {
+    VK_FORMAT_R32G32B32A32_SFLOAT,
+    VK_FORMAT_R16G16B16A16_UNORM,
+    VK_FORMAT_R8G8B8A8_UNORM,
+};
+
+struct IngestInfo {
+    // Ingested in this order, every one exactly once
+    std::vector<std::string> paths;
+    uint32_t width;
+    uint32_t height;
+    // One of ingestFormats, the format of the goal image
+    VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    // Images decoded ahead of the one in use, each takes one layer worth of staging memory
+    uint32_t nrSlots = 8;
+    // 0 for one per core
+    uint32_t nrThreads = 0;
+};
+
+// Written by the workers, handed out in order by ingestUpload
+struct IngestQueue {
+    std::mutex mutex;
+    // Workers wait for a free slot, the owner for a decoded image
+    std::condition_variable slotFreed;
+    std::condition_variable decoded;
+    bool running;
+    uint32_t nextDecode;
+    // Jobs below it have left their slot
+    uint32_t released;
+    // Per slot, empty while decoding, then "ok" or the reason it failed
+    std::vector<std::string> results;
+    std::vector<std::thread> threads;
+};
+
+// Decodes the goal images of a batch on a pool of threads, nrSlots ahead of the evolution.
+// Files are mapped instead of read and converted straight into a persistently mapped staging
+// buffer, so the loop only records the copy into the goal layer. Decoding gives the same
+// linear values as stbi_loadf, in compact formats quantized.
+struct Ingest {
+    IngestInfo info;
+    size_t layerSize;
+    Buffer staging;
+    uint8_t* mapped;
+    std::unique_ptr<IngestQueue> queue;
+    uint32_t nextUpload;
+    // Job and uploader timeline value of the copies still reading from the staging buffer
+    std::deque<std::pair<uint32_t, uint64_t>> uploading;
+};
+
+Ingest ingestCreate(Ctx& ctx, IngestInfo& info);
+// Stops the workers after the image they are on
+void ingestDestroy(Ctx& ctx, Ingest& ingest);
+// Queues the copy of the next image in the list into a layer, blocks only if it is not decoded yet.
+// Crashes if the image could not be loaded, like uploadImageLayerD.
+void ingestUpload(Ctx& ctx, Ingest& ingest, Image& image, uint32_t layer, VkImageLayout layout);
+// Hands the slots of finished copies back to the workers, once per frame
+void ingestRetire(Ctx& ctx, Ingest& ingest);
+size_t ingestTexelSize(VkFormat format);
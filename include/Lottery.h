@@ -2,27 +2,33 @@
 #include <precomp.h>
 #include <Comp.h>
 #include <BufferTools.h>
+#include <RenderGraph.h>
 
 struct LotteryInfo {
     Buffer* scoreBuffer;
     Buffer* parentBuffer;
+    uint32_t nrInstances;
+    uint32_t nrInstancesPerGroup;
 };
 
 struct Lottery {
+    LotteryInfo info;
     CompPipeline pipeline;
     VkDescriptorSet descriptorSet;
 };
 
 struct LotteryArgs {
-    uint32_t nrInstances;
-    uint32_t instanceWidth;
-    uint32_t instanceHeight;
-    uint32_t seed;
+    uint32_t runSeed;
+    uint32_t generation;
+    // Share of the group's lowest score taken off every score before the draws,
+    // higher values favour the best instances more
+    float shift = 0.85f;
 };
 
 Lottery lotteryCreate(Ctx& ctx, LotteryInfo& info);
 void lotteryDestroy(Ctx& ctx, Lottery& evolve);
 void lotteryRecord(Ctx& ctx, Lottery& evolve, LotteryArgs& args);
+void lotteryAddPass(Ctx& ctx, RenderGraph& graph, Lottery& lottery, LotteryArgs args);
 
 
 
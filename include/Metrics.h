@@ -0,0 +1,68 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+#include <Profiler.h>
+#include <Sockets.h>
+#include <atomic>
+#include <thread>
+
+// Passes with their own GPU time series, the rest is dropped
+constexpr uint32_t metricsMaxStages = 64;
+constexpr uint32_t metricsMaxGoals = 64;
+
+struct MetricsInfo {
+    SocketEndpoint endpoint { .port = 9464 };
+};
+
+struct MetricsStage {
+    // A pass name, the graph passes keep theirs alive for the whole run
+    std::atomic<const char*> name;
+    std::atomic<double> seconds;
+};
+
+struct MetricsHeap {
+    std::atomic<uint64_t> usage;
+    std::atomic<uint64_t> budget;
+};
+
+struct MetricsGoal {
+    std::atomic<float> bestFitness;
+    std::atomic<float> meanFitness;
+};
+
+// Written by the evolution loop, read by the server thread. Everything is a relaxed atomic,
+// a scrape may mix values of neighbouring generations.
+struct MetricsCounters {
+    std::atomic<bool> running;
+    std::atomic<uint64_t> generations;
+    std::atomic<double> generationsPerSecond;
+    // Host time in the last ctxEndFrame, most of it the queue submit
+    std::atomic<double> submitSeconds;
+    // Host time the last ctxBeginFrame waited for the frame before it
+    std::atomic<double> frameWaitSeconds;
+    std::array<MetricsStage, metricsMaxStages> stages;
+    std::array<MetricsHeap, VK_MAX_MEMORY_HEAPS> heaps;
+    std::atomic<uint32_t> nrHeaps;
+    std::array<MetricsGoal, metricsMaxGoals> goals;
+    std::atomic<uint32_t> nrGoals;
+    std::thread thread;
+    int listenSocket;
+};
+
+// Prometheus text format over HTTP on localhost or a unix socket, served from its own thread
+// so a scrape never stalls the loop. curl localhost:9464/metrics or curl --unix-socket path x/metrics.
+struct Metrics {
+    MetricsInfo info;
+    double lastFrame;
+    std::unique_ptr<MetricsCounters> counters;
+};
+
+Metrics metricsCreate(MetricsInfo& info);
+// Joins the server thread
+void metricsDestroy(Metrics& metrics);
+// Once per generation, with the host times of the last ctxBeginFrame and ctxEndFrame
+void metricsFrame(Metrics& metrics, double frameWaitSeconds, double submitSeconds);
+void metricsStages(Metrics& metrics, const std::vector<ProfilerScope>& scopes);
+void metricsFitness(Metrics& metrics, uint32_t goal, float bestFitness, float meanFitness);
+// Reads the VMA budgets, not meant for every frame
+void metricsMemory(Metrics& metrics, const Ctx& ctx);
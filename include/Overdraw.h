@@ -0,0 +1,46 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+
+// Debug pass measuring how many of its triangles cover every pixel of an instance,
+// the fragment work the grid render spends per pixel it outputs.
+struct OverdrawInfo {
+    Buffer* vertexBuffers[2];
+    // Active triangles per instance, only with variable length genomes
+    Buffer* drawBuffers[2] = {};
+    uint32_t nrInstances;
+    uint32_t nrTrianglesPerInstance;
+    // Both multiples of 16
+    uint32_t instanceWidth;
+    uint32_t instanceHeight;
+};
+
+struct Overdraw {
+    OverdrawInfo info;
+    CompPipeline pipeline;
+    VkDescriptorSet descriptorSets[2];
+    // nrTrianglesPerInstance + 1 bins per instance, see overdraw.comp
+    Buffer histograms;
+    Buffer histogramsReadback;
+};
+
+// Spread of one histogram
+struct OverdrawSummary {
+    // Triangles per pixel
+    float mean;
+    uint32_t median;
+    uint32_t p99;
+    uint32_t max;
+};
+
+Overdraw overdrawCreate(Ctx& ctx, OverdrawInfo& info);
+void overdrawDestroy(Ctx& ctx, Overdraw& overdraw);
+void overdrawRecord(Ctx& ctx, Overdraw& overdraw);
+// Measures the genomes the grid render draws this frame
+void overdrawAddPasses(Ctx& ctx, RenderGraph& graph, Overdraw& overdraw);
+// Histograms of the last frame that added the passes, never waits. Only call after ctxBeginFrame.
+std::vector<uint32_t> overdrawHistograms(Ctx& ctx, Overdraw& overdraw);
+// Over bins.size() bins, of one instance or summed over many
+OverdrawSummary overdrawSummarize(const std::vector<uint64_t>& bins);
@@ -0,0 +1,67 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+#include <Reduce.h>
+
+// Keep in sync with shaders/plateau.comp
+enum PlateauStatus : uint32_t {
+    PLATEAU_RUNNING = 0,
+    // The best fitness reached targetFitness
+    PLATEAU_TARGET = 1,
+    // A whole window of generations gained less than minImprovement
+    PLATEAU_STALLED = 2,
+    PLATEAU_BUDGET = 3,
+};
+
+// Per goal, as tracked on the GPU. Scores are as graded, fitness is per pixel without the base of 1.
+struct PlateauState {
+    float best;
+    float mean;
+    // Best score when the current window started
+    float windowBest;
+    // Index of the best instance among all instances
+    uint32_t bestInstance;
+    uint32_t windowStart;
+    uint32_t generations;
+    PlateauStatus status;
+    uint32_t pad;
+};
+
+// Decides per goal when evolving it further is not worth the device time. Everything is
+// decided on the GPU, the host only polls a copy of the small state after the frame fence.
+struct PlateauInfo {
+    Buffer* scoreBuffer;
+    uint32_t nrInstances;
+    uint32_t nrInstancesPerGoal;
+    uint32_t pixelsPerInstance;
+    float targetFitness = 0.9f;
+    // Stalled when window generations in a row gain less than minImprovement fitness
+    uint32_t window = 1000;
+    float minImprovement = 0.001f;
+    uint32_t maxGenerations = 100000;
+};
+
+struct Plateau {
+    PlateauInfo info;
+    uint32_t nrGoals;
+    Reduce bests;
+    Reduce sums;
+    CompPipeline pipeline;
+    VkDescriptorSet descriptorSet;
+    Buffer states;
+    Buffer statesReadback;
+};
+
+Plateau plateauCreate(Ctx& ctx, PlateauInfo& info);
+void plateauDestroy(Ctx& ctx, Plateau& plateau);
+void plateauRecord(Ctx& ctx, Plateau& plateau);
+// Between the grader and the lottery, the lottery resets the scores
+void plateauAddPasses(Ctx& ctx, RenderGraph& graph, Plateau& plateau);
+// State of every goal as of the last finished frame, never waits. Only call after ctxBeginFrame.
+std::vector<PlateauState> plateauPoll(Ctx& ctx, Plateau& plateau);
+// Starts tracking a goal over, for new genomes. Staged like any upload, before the next frame.
+void plateauReset(Ctx& ctx, Plateau& plateau, uint32_t goal);
+float plateauFitness(const Plateau& plateau, float score);
+const char* plateauStatusName(PlateauStatus status);
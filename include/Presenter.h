@@ -0,0 +1,49 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+#include <ImageTools.h>
+#include <QuadRender.h>
+#include <RenderGraph.h>
+#include <atomic>
+#include <thread>
+
+struct PresenterInfo {
+    // Layer 0 is copied, needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+    const Image* source;
+    // Minimum seconds between two snapshots
+    double interval = 1.0 / 60.0;
+};
+
+// Owned by the presenter thread, only running is touched from outside
+struct PresenterThread {
+    std::atomic<bool> running;
+    std::thread thread;
+    VkCommandPool commandPool;
+    VkCommandBuffer cmdBuffer;
+    VkSemaphore imageAvailable;
+    VkSemaphore renderFinished;
+    VkFence fence;
+};
+
+// Shows snapshots of the grid from its own thread, so the evolution loop never waits on the swapchain.
+// Needs a ctx with detachedPresent, the frames of the loop then only copy a snapshot now and then.
+struct Presenter {
+    PresenterInfo info;
+    Image snapshot;
+    QuadRender quadRender;
+    // Signalled by the frame that copied a snapshot, with snapshotValue
+    VkSemaphore snapshotTimeline;
+    // Signalled by the presenter once it sampled that snapshot
+    VkSemaphore shownTimeline;
+    uint64_t snapshotValue;
+    double lastSnapshot;
+    std::unique_ptr<PresenterThread> presentThread;
+};
+
+Presenter presenterCreate(Ctx& ctx, PresenterInfo& info);
+// Joins the presenter thread, call before ctxFinish
+void presenterStop(Ctx& ctx, Presenter& presenter);
+void presenterDestroy(Ctx& ctx, Presenter& presenter);
+// Adds a snapshot copy once the interval passed and the last snapshot was shown, returns whether it did.
+// The snapshot image has to be imported into the graph as VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+bool presenterAddPasses(Ctx& ctx, RenderGraph& graph, Presenter& presenter);
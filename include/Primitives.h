@@ -50,3 +50,84 @@ struct RandGen<Vertex> {
         return { { randf(0.5f)-1, randf(0.5f)-1, 0, 0 }, { randf(0.1f), randf(0.1f), randf(0.1f), randf(0.1f)+0.5f } };
     }
 };
+
+// Random genomes keyed by (run seed, job, instance, triangle), independent of the order they are generated in
+inline std::vector<Vertex> randomGenomes(uint32_t runSeed, uint32_t job, uint32_t firstInstance, uint32_t nrInstances, uint32_t trianglesPerInstance) {
+    std::vector<Vertex> ret;
+    ret.reserve(3 * nrInstances * trianglesPerInstance);
+    for (uint32_t instance=firstInstance; instance<firstInstance+nrInstances; instance++) {
+        for (uint32_t triangle=0; triangle<trianglesPerInstance; triangle++) {
+            CounterRng rng(runSeed, RNG_STREAM_INIT, job, instance, triangle);
+            for (uint32_t v=0; v<3; v++) {
+                ret.push_back(Vertex {
+                    { rng.randf(), rng.randf(), 0, 0 },
+                    { rng.randf(1.0f), rng.randf(1.0f), rng.randf(1.0f), 0.1f, }
+                });
+            }
+        }
+    }
+    return ret;
+}
+
+// Draws of variable-length genomes, every instance starts out with the same active triangles
+inline std::vector<VkDrawIndirectCommand> genomeDraws(uint32_t firstInstance, uint32_t nrInstances, uint32_t activeTriangles) {
+    std::vector<VkDrawIndirectCommand> ret;
+    ret.reserve(nrInstances);
+    for (uint32_t instance=firstInstance; instance<firstInstance+nrInstances; instance++) {
+        ret.push_back(VkDrawIndirectCommand {
+            .vertexCount = 3 * activeTriangles,
+            .instanceCount = 1,
+            .firstVertex = 0,
+            .firstInstance = instance,
+        });
+    }
+    return ret;
+}
+
+// Pools of indexed genomes, keyed like randomGenomes by (run seed, job, instance, vertex)
+inline std::vector<Vertex> randomMeshVertices(uint32_t runSeed, uint32_t job, uint32_t firstInstance, uint32_t nrInstances, uint32_t meshVertices) {
+    std::vector<Vertex> ret;
+    ret.reserve(nrInstances * meshVertices);
+    for (uint32_t instance=firstInstance; instance<firstInstance+nrInstances; instance++) {
+        for (uint32_t v=0; v<meshVertices; v++) {
+            CounterRng rng(runSeed, RNG_STREAM_INIT, job, instance, v);
+            ret.push_back(Vertex {
+                { rng.randf(), rng.randf(), 0, 0 },
+                { rng.randf(1.0f), rng.randf(1.0f), rng.randf(1.0f), 0.1f, }
+            });
+        }
+    }
+    return ret;
+}
+
+// Three indices into the instance's own pool per triangle, keyed after the vertices of the pool
+inline std::vector<uint32_t> randomMeshIndices(uint32_t runSeed, uint32_t job, uint32_t firstInstance, uint32_t nrInstances,
+        uint32_t meshVertices, uint32_t trianglesPerInstance) {
+    std::vector<uint32_t> ret;
+    ret.reserve(3 * nrInstances * trianglesPerInstance);
+    for (uint32_t instance=firstInstance; instance<firstInstance+nrInstances; instance++) {
+        for (uint32_t triangle=0; triangle<trianglesPerInstance; triangle++) {
+            CounterRng rng(runSeed, RNG_STREAM_INIT, job, instance, meshVertices + triangle);
+            for (uint32_t k=0; k<3; k++) {
+                ret.push_back(rng.randu() % meshVertices);
+            }
+        }
+    }
+    return ret;
+}
+
+// Per instance one indexed draw of its triangles, the vertex shader pulls from the pool of firstInstance
+inline std::vector<VkDrawIndexedIndirectCommand> meshDraws(uint32_t nrInstances, uint32_t trianglesPerInstance) {
+    std::vector<VkDrawIndexedIndirectCommand> ret;
+    ret.reserve(nrInstances);
+    for (uint32_t instance=0; instance<nrInstances; instance++) {
+        ret.push_back(VkDrawIndexedIndirectCommand {
+            .indexCount = 3 * trianglesPerInstance,
+            .instanceCount = 1,
+            .firstIndex = 3 * trianglesPerInstance * instance,
+            .vertexOffset = 0,
+            .firstInstance = instance,
+        });
+    }
+    return ret;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+
+// GPU time and pipeline statistics of the passes of a frame. Set RenderGraph::profiler on the
+// frames to measure, every pass is then wrapped in its own queries. The statistics need
+// ctx.pipelineStatistics, the times a device with timestampComputeAndGraphics.
+struct ProfilerInfo {
+    // Queries per frame, one per pass
+    uint32_t maxScopes = 64;
+    bool statistics = true;
+};
+
+// Counters of one pass, in the order of profilerStatistics. Zero for what is not measured.
+struct ProfilerScope {
+    const char* name;
+    double seconds;
+    uint64_t inputPrimitives;
+    uint64_t vertexInvocations;
+    // Primitives that make it past clipping to the rasterizer
+    uint64_t clippingPrimitives;
+    uint64_t fragmentInvocations;
+    uint64_t computeInvocations;
+};
+
+constexpr VkQueryPipelineStatisticFlags profilerStatistics =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+struct Profiler {
+    ProfilerInfo info;
+    // VK_NULL_HANDLE for what the device cannot measure
+    VkQueryPool statisticsPool;
+    // A timestamp before and after every pass
+    VkQueryPool timestampPool;
+    // Seconds per timestamp tick
+    double timestampPeriod;
+    // Passes wrapped in the frame that was recorded last, a query each
+    std::vector<const char*> scopes;
+};
+
+Profiler profilerCreate(Ctx& ctx, ProfilerInfo& info);
+void profilerDestroy(Ctx& ctx, Profiler& profiler);
+// Call on the frames to measure, before the first pass is recorded
+void profilerBeginFrame(Ctx& ctx, Profiler& profiler);
+// Outside of render passes, renderGraphExecute does this around every pass
+void profilerBeginScope(Ctx& ctx, Profiler& profiler, const char* name);
+void profilerEndScope(Ctx& ctx, Profiler& profiler);
+// Counters of the last measured frame, once. Never waits, only call after ctxBeginFrame.
+std::vector<ProfilerScope> profilerResults(Ctx& ctx, Profiler& profiler);
+// One line per pass that did any work
+void profilerLog(const std::vector<ProfilerScope>& scopes);
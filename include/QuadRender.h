@@ -3,6 +3,8 @@
 #include <Ctx.h>
 #include <RenderPass.h>
 #include <Rast.h>
+#include <ImageTools.h>
+#include <RenderGraph.h>
 
 
 struct QuadRenderInfo {
@@ -11,13 +13,19 @@ struct QuadRenderInfo {
 };
 
 struct QuadRender {
+    QuadRenderInfo info;
     RenderPass renderPass;
     RastPipeline pipeline;
     VkDescriptorSetLayout descriptorLayout;
     VkDescriptorSet descriptorSet;
     VkSampler sampler;
+    // Only the first layer of a layered grid is shown
+    VkImageView srcView;
 };
 
 QuadRender quadRenderCreate(Ctx& ctx, QuadRenderInfo& info);
 void quadRenderDestroy(Ctx& ctx, QuadRender& render);
 void quadRenderRecord(Ctx& ctx, QuadRender& quadRender);
+// Into any command buffer and swapchain image, the presenter records from its own thread
+void quadRenderRecord(Ctx& ctx, QuadRender& quadRender, VkCommandBuffer cmdBuffer, uint32_t imageIdx);
+void quadRenderAddPass(Ctx& ctx, RenderGraph& graph, QuadRender& quadRender);
@@ -5,12 +5,16 @@
 #include <Primitives.h>
 
 struct RastPipelineInfo {
-    const char* vsPath;
-    const char* fsPath;
+    const char* vertShader;
+    const char* fragShader;
     RenderPass* renderPass;
     VertexDescription* vertexDescription;
     std::vector<VkPushConstantRange> pushConstantRanges;
     std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+    // constant_id i is specialized to specializationConstants[i] in both stages
+    std::vector<uint32_t> specializationConstants;
+    // Defaults to the window size when left empty
+    VkExtent2D viewport;
 };
 
 struct RastPipeline {
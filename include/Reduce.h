@@ -0,0 +1,79 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <RenderGraph.h>
+
+// Keep in sync with shaders/reduce_ops.glsl
+enum ReduceOp : uint32_t {
+    REDUCE_OP_ADD = 0,
+    REDUCE_OP_MIN = 1,
+    REDUCE_OP_MAX = 2,
+};
+
+enum ReduceType : uint32_t {
+    REDUCE_TYPE_UINT = 0,
+    REDUCE_TYPE_FLOAT = 1,
+};
+
+enum ReduceMode : uint32_t {
+    REDUCE_MODE_REDUCE,
+    REDUCE_MODE_INCLUSIVE_SCAN,
+    REDUCE_MODE_EXCLUSIVE_SCAN,
+};
+
+// Values folded by one workgroup, segments longer than this take another level
+constexpr uint32_t reduceGroupValues = 256 * 4;
+
+// Result of a reduce per segment. value holds the bits of the result, index the
+// position within the segment of the min or max (the first one on ties).
+struct ReducePair {
+    uint32_t value;
+    uint32_t index;
+};
+
+// Device wide reduce or scan over nrSegments independent segments of segmentSize
+// 32 bit values, a single segment covers the whole input. Always in a fixed order,
+// float results are reproducible bit for bit.
+struct ReduceInfo {
+    ReduceMode mode = REDUCE_MODE_REDUCE;
+    ReduceOp op = REDUCE_OP_ADD;
+    ReduceType type = REDUCE_TYPE_FLOAT;
+    Buffer* input;
+    // A ReducePair per segment or a value per input value for the scans,
+    // allocated by the reduce when left empty
+    Buffer* output = nullptr;
+    uint32_t segmentSize;
+    uint32_t nrSegments = 1;
+};
+
+struct ReduceLevel {
+    uint32_t segmentSize;
+    uint32_t groupsPerSegment;
+    // Reduce: the partials this level writes, scans: the chunk totals it writes.
+    // Not allocated on the last level.
+    Buffer partials;
+    // Scans after the first level: the scanned totals of the level before
+    Buffer scanned;
+    VkDescriptorSet descriptorSet;
+    VkDescriptorSet addDescriptorSet;
+};
+
+struct Reduce {
+    ReduceInfo info;
+    // Handles only, so the reduce does not depend on where the buffers live
+    Buffer input;
+    Buffer output;
+    bool ownsOutput;
+    // Reduce: first level / later levels, scans: the requested scan / exclusive scan of the totals
+    CompPipeline firstPipeline;
+    CompPipeline levelPipeline;
+    // Scans only, adds the scanned totals to the chunks after them
+    CompPipeline addPipeline;
+    std::vector<ReduceLevel> levels;
+};
+
+Reduce reduceCreate(Ctx& ctx, ReduceInfo& info);
+void reduceDestroy(Ctx& ctx, Reduce& reduce);
+void reduceRecord(Ctx& ctx, Reduce& reduce);
+void reduceAddPass(Ctx& ctx, RenderGraph& graph, Reduce& reduce);
@@ -0,0 +1,72 @@
+#pragma once
+#include <precomp.h>
+#include <Comp.h>
+#include <BufferTools.h>
+#include <Primitives.h>
+#include <RenderGraph.h>
+#include <Reduce.h>
+
+// Keep in sync with shaders/refine.comp
+constexpr float refineMinCoverage = 1e-4f;
+constexpr float refineMinArea = 1e-6f;
+constexpr float refineMaxAlpha = 0.95f;
+
+// Gradient ascent on the grader score of the best instance of every goal, in place in the
+// vertex buffer the lottery and evolve read next. The score is taken on a soft rasterization
+// of the genome, see refine.comp, and followed with Adam for a few steps.
+struct RefineInfo {
+    Buffer* vertexBuffers[2];
+    // Active triangles per instance, only with variable length genomes
+    Buffer* drawBuffers[2] = {};
+    // Scores of the frame, the champions are picked after grading
+    Buffer* scoreBuffer;
+    Image* goal;
+    uint32_t nrInstances;
+    uint32_t nrInstancesPerGoal;
+    uint32_t nrTrianglesPerInstance;
+    // Both multiples of 16
+    uint32_t instanceWidth;
+    uint32_t instanceHeight;
+    uint32_t steps = 10;
+    // Edge softness in pixels
+    float sigma = 0.5f;
+    // Step sizes of Adam, positions are in instance units
+    float positionRate = 0.002f;
+    float colorRate = 0.005f;
+};
+
+// Push constants of refine.comp
+struct RefineArgs {
+    uint32_t step;
+    float sigma;
+    float positionRate;
+    float colorRate;
+};
+
+struct Refine {
+    RefineInfo info;
+    uint32_t nrGoals;
+    // Max over the scores of each goal
+    Reduce champions;
+    CompPipeline gradientPipeline;
+    CompPipeline adamPipeline;
+    VkDescriptorSet gradientDescriptorSets[2];
+    VkDescriptorSet adamDescriptorSets[2];
+    // d score / d parameter per vertex of the champions, then the moments of Adam,
+    // all laid out like the champions' vertices one goal after the other
+    Buffer gradients;
+    Buffer adamM;
+    Buffer adamV;
+};
+
+Refine refineCreate(Ctx& ctx, RefineInfo& info);
+void refineDestroy(Ctx& ctx, Refine& refine);
+void refineRecord(Ctx& ctx, Refine& refine);
+// Between the grader and the lottery, the refined champions then compete as parents
+void refineAddPasses(Ctx& ctx, RenderGraph& graph, Refine& refine);
+// Gradients of the last step for one goal, blocks until they are downloaded
+std::vector<Vertex> refineDownloadGradients(Ctx& ctx, Refine& refine, uint32_t goal);
+// CPU reference of the gradient pass. Goal holds rgba floats row by row, gradients gets
+// the gradient of the soft score per vertex. Returns the soft score without the base of 1.
+float refineReferenceGradients(const RefineInfo& info, const Vertex* genome, uint32_t nrTriangles,
+        const float* goal, std::vector<Vertex>& gradients);
@@ -0,0 +1,50 @@
+#pragma once
+#include <precomp.h>
+#include <Ctx.h>
+
+struct Profiler;
+
+// How a pass touches a buffer or an image, in synchronization2 terms
+struct GraphUse {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    const Image* image = nullptr;
+    VkPipelineStageFlags2KHR stage;
+    VkAccessFlags2KHR access;
+    // Images only, the layout the pass expects
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // The pass overwrites all of it, so a layout change may drop the old content
+    bool discard = false;
+};
+
+struct GraphPass {
+    const char* name;
+    std::vector<GraphUse> uses;
+    std::function<void(Ctx&)> record;
+};
+
+// Synchronization scope of the last access to a resource, kept across frames
+struct GraphResourceState {
+    VkPipelineStageFlags2KHR writeStage = 0;
+    VkAccessFlags2KHR writeAccess = 0;
+    // Readers since the last write, they already see it and a writer has to wait for them
+    VkPipelineStageFlags2KHR readStages = 0;
+    VkAccessFlags2KHR readAccess = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+struct RenderGraph {
+    std::vector<GraphPass> passes;
+    std::unordered_map<uint64_t, GraphResourceState> states;
+    // Resources sharing memory are tracked as one, the key is the first of them
+    std::unordered_map<uint64_t, uint64_t> aliases;
+    // Wraps every pass in a pipeline statistics query while set
+    Profiler* profiler = nullptr;
+};
+
+// Images start out UNDEFINED, anything created in another layout has to be imported
+void renderGraphImportImage(RenderGraph& graph, const Image& image, VkImageLayout layout);
+// buffer shares its memory with sharesWith, so using one of them has to wait for the other
+void renderGraphAlias(RenderGraph& graph, VkBuffer buffer, VkBuffer sharesWith);
+void renderGraphAddPass(RenderGraph& graph, GraphPass pass);
+// Records the passes added since the last call, each preceded by one batch with the barriers it needs
+void renderGraphExecute(Ctx& ctx, RenderGraph& graph);
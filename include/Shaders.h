@@ -0,0 +1,14 @@
+#pragma once
+#include <precomp.h>
+#include <span>
+#include <string_view>
+
+namespace shaders {
+    // SPIR-V of every shader() in CMakeLists.txt, keyed by its source file name (e.g. "grid.vert")
+    extern const std::unordered_map<std::string_view, std::span<const uint32_t>> embedded;
+
+    VkShaderModule createModule(VkDevice device, const char* name);
+
+    // Maps constants[i] to constant_id i, entries must outlive the returned info
+    VkSpecializationInfo specializationInfo(const std::vector<uint32_t>& constants, std::vector<VkSpecializationMapEntry>& entries);
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <precomp.h>
+#include <string_view>
+
+// Endpoint of a local server, TCP on localhost when path is nullptr
+struct SocketEndpoint {
+    uint16_t port = 0;
+    // Unix domain socket, replaced if it exists
+    const char* path = nullptr;
+};
+
+// Parses a port number or else takes the argument as the path of a unix socket
+SocketEndpoint socketParseEndpoint(const char* endpoint);
+// Listening socket, crashes when it cannot be bound
+int socketListen(const SocketEndpoint& endpoint);
+// Waits up to timeoutMs for a connection, -1 if none came
+int socketAccept(int listenSocket, int timeoutMs);
+// Writes all of data, false once the peer is gone
+bool socketSend(int socket, std::string_view data);
+void socketClose(int socket, const SocketEndpoint& endpoint);
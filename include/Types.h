@@ -8,4 +8,10 @@ struct Image {
     VkFormat format;
     uint32_t width;
     uint32_t height;
+    uint32_t layers = 1;
+};
+
+struct Buffer {
+    VkBuffer buffer;
+    VmaAllocation memory;
 };
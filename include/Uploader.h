@@ -0,0 +1,49 @@
+#pragma once
+#include <precomp.h>
+#include <Types.h>
+#include <deque>
+
+struct Ctx;
+
+struct UploadBatch {
+    VkCommandBuffer cmdBuffer;
+    // Signalled on the uploader timeline once the copies of the batch are done
+    uint64_t value;
+    // Ring position up to which the batch holds staging data
+    size_t ringEnd;
+};
+
+// Uploads are written into a persistently mapped staging ring and the copies out of it are
+// batched into a single submit on the transfer queue, which signals a timeline semaphore.
+// The next ctxEndFrame flushes the pending batch and waits on it on the GPU, not on the host.
+struct Uploader {
+    Buffer ring;
+    uint8_t* mapped;
+    size_t ringSize;
+    // Monotonic byte positions, [tail, head) of the ring is still read by the GPU
+    size_t head;
+    size_t tail;
+    VkCommandPool commandPool;
+    VkSemaphore timeline;
+    // Value signalled by the last submitted batch
+    uint64_t submittedValue;
+    // Batch being recorded, VK_NULL_HANDLE if nothing is pending
+    VkCommandBuffer pending;
+    std::deque<UploadBatch> inFlight;
+};
+
+Uploader uploaderCreate(Ctx& ctx, size_t ringSize);
+void uploaderDestroy(Ctx& ctx, Uploader& uploader);
+// The destination must not be in use by work already submitted to the graphics queue
+void uploaderBuffer(Ctx& ctx, Uploader& uploader, const Buffer& dst, size_t offset, size_t size, const void* data);
+// The previous contents of the layer are discarded, it ends up in the given layout
+void uploaderImageLayer(Ctx& ctx, Uploader& uploader, const Image& image, uint32_t layer, VkImageLayout layout, const void* pixels, size_t size);
+// Same as uploaderImageLayer, but from a host buffer the caller filled and keeps alive until the
+// returned timeline value is reached, so the pixels need not pass through the ring
+uint64_t uploaderCopyImageLayer(Ctx& ctx, Uploader& uploader, const Buffer& src, size_t srcOffset, const Image& image, uint32_t layer, VkImageLayout layout);
+// Initial layout transition of all layers of a freshly created image
+void uploaderTransition(Ctx& ctx, Uploader& uploader, const Image& image, VkImageLayout layout);
+// Submits the pending batch, returns the timeline value to wait on for everything uploaded so far
+uint64_t uploaderFlush(Ctx& ctx, Uploader& uploader);
+bool uploaderDone(Ctx& ctx, Uploader& uploader, uint64_t value);
+void uploaderWait(Ctx& ctx, Uploader& uploader, uint64_t value);
@@ -1,35 +1,72 @@
-uint rand_xorshift(in uint seed) {
-    // Xorshift algorithm from George Marsaglia's paper
-    seed ^= (seed << 13);
-    seed ^= (seed >> 17);
-    seed ^= (seed << 5);
-    return seed;
+// Streams of the counter based generator, keep in sync with RngStream in General.h
+const uint RNG_STREAM_INIT = 0;
+const uint RNG_STREAM_LOTTERY = 1;
+const uint RNG_STREAM_EVOLVE = 2;
+const uint RNG_STREAM_GRADER = 3;
+const uint RNG_STREAM_CLIMB = 4;
+
+// Philox4x32-10 (Salmon et al.), bit identical to philox4x32 in General.cpp
+uvec4 philox4x32(uvec4 ctr, uvec2 key) {
+    for (int round = 0; round < 10; round++) {
+        uint hi0, lo0, hi1, lo1;
+        umulExtended(0xD2511F53u, ctr.x, hi0, lo0);
+        umulExtended(0xCD9E8D57u, ctr.z, hi1, lo1);
+        ctr = uvec4(hi1 ^ ctr.y ^ key.x, lo1, hi0 ^ ctr.w ^ key.y, lo0);
+        key += uvec2(0x9E3779B9u, 0xBB67AE85u);
+    }
+    return ctr;
 }
 
-uint g_seed;
+uvec2 g_rngKey;
+uvec4 g_rngCounter;
+uvec4 g_rngBlock;
+uint g_rngIdx;
 
-void initRand(in uint seed, in uint id) {
-    g_seed = 5 + 23 * rand_xorshift(666 + seed + rand_xorshift(17 * id));
+// The numbers drawn only depend on the arguments, never on scheduling
+void initRand(in uint runSeed, in uint stream, in uint generation, in uint instance, in uint element) {
+    g_rngKey = uvec2(runSeed, stream);
+    g_rngCounter = uvec4(generation, instance, element, 0);
+    g_rngIdx = 4;
 }
 
 uint randu() {
-    g_seed = rand_xorshift(g_seed);
-    return g_seed;
+    if (g_rngIdx == 4) {
+        g_rngBlock = philox4x32(g_rngCounter, g_rngKey);
+        g_rngCounter.w++;
+        g_rngIdx = 0;
+    }
+    return g_rngBlock[g_rngIdx++];
 }
 float randf() {
     // Faster on GPU probably
     return randu() * 2.3283064365387e-10f;
 }
+// Standard normal by Box-Muller, takes two draws
+float randNormal() {
+    float u = max(randf(), 1e-7f);
+    return sqrt(-2.0f * log(u)) * cos(6.2831853f * randf());
+}
 
 struct Vertex {
     vec4 pos;
     vec4 color;
 };
 
+// Entry of the duplicates buffer for instances that have to be rendered and graded
+#define NO_DUPLICATE 0xFFFFFFFFu
+
+// VkDrawIndirectCommand, vertexCount holds 3 times the active triangles of a genome
+struct DrawCommand {
+    uint vertexCount;
+    uint instanceCount;
+    uint firstVertex;
+    uint firstInstance;
+};
+
 Vertex randVertex() {
     Vertex ret;
-    ret.pos.x = randf();
-    ret.pos.y = randf();
+    // zw are hashed by the dedup like the rest
+    ret.pos = vec4(randf(), randf(), 0.0, 0.0);
     ret.color.r = randf();
     ret.color.g = randf();
     ret.color.b = randf();
@@ -37,6 +74,18 @@ Vertex randVertex() {
     return ret;
 }
 
+void mutate(inout Vertex v) {
+    float rf = randf();
+    switch (randu() % 6) {
+        case 0: v.pos.x = rf; break;
+        case 1: v.pos.y = rf; break;
+        case 2: v.color.r = rf; break;
+        case 3: v.color.g = rf; break;
+        case 4: v.color.b = rf; break;
+        case 5: v.color.a = rf * 0.2f; break;
+    }
+}
+
 float brightness(vec3 col) {
     return dot(vec3(0.299, 0.587, 0.114), col);
 }
@@ -3,27 +3,28 @@
 layout(location = 0) in vec4 vPos;
 layout(location = 1) in vec4 vColor;
 
-layout(push_constant) uniform Constants {
-    uint nrTriangles;
-    uint nrInstanceWidth;
-    uint nrInstanceHeight;
-} constants;
+layout(constant_id = 0) const uint nrTriangles = 3600;
+layout(constant_id = 1) const uint nrInstanceWidth = 6;
+layout(constant_id = 2) const uint nrInstanceHeight = 6;
+layout(constant_id = 3) const uint nrLayers = 1;
 
 layout(location = 0) out vec2 uv;
 layout(location = 1) out vec4 color;
 
 void main() {
-    uint totalInstances = constants.nrInstanceWidth * constants.nrInstanceHeight;
+    uint instancesPerLayer = nrInstanceWidth * nrInstanceHeight;
+    uint trianglesPerInstance = nrTriangles / (instancesPerLayer * nrLayers);
     uint triangleId = gl_VertexIndex / 3;
-    uint instanceId = (totalInstances * triangleId) / constants.nrTriangles;
-    float instanceIdx = mod(instanceId, constants.nrInstanceWidth);
-    float instanceIdy = instanceId / constants.nrInstanceHeight;
+    // the layer is picked by the render pass, only the cell within it matters here
+    uint cell = (triangleId / trianglesPerInstance) % instancesPerLayer;
+    float instanceIdx = cell % nrInstanceWidth;
+    float instanceIdy = cell / nrInstanceWidth;
 
     // [0 .. {width,height}]
     vec2 offs = vec2(instanceIdx, instanceIdy);
 
     // [0 .. 1]
-    vec2 normalizedPos = (vPos.xy + offs) / vec2(constants.nrInstanceWidth, constants.nrInstanceHeight);
+    vec2 normalizedPos = (vPos.xy + offs) / vec2(nrInstanceWidth, nrInstanceHeight);
 
     gl_Position = vec4(normalizedPos * 2 - 1, 0.0f, 1.0f);
     uv = normalizedPos;
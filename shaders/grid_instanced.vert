@@ -0,0 +1,38 @@
+#version 460
+#include "common.glsl"
+
+// per instance: the cell of the grid layer, x0 y0 x1 y1 in [0 .. 1]
+layout(location = 0) in vec4 cellRect;
+
+layout(std430, binding = 0, set = 0) readonly buffer Vertices { Vertex vertices[]; };
+
+layout(constant_id = 0) const uint nrTriangles = 3600;
+layout(constant_id = 1) const uint nrInstanceWidth = 6;
+layout(constant_id = 2) const uint nrInstanceHeight = 6;
+layout(constant_id = 3) const uint nrLayers = 1;
+// Size of the vertex pool of indexed mesh genomes, 0 for three vertices per triangle
+layout(constant_id = 4) const uint meshVertices = 0;
+
+layout(location = 0) out vec2 uv;
+layout(location = 1) out vec4 color;
+
+out float gl_ClipDistance[4];
+
+void main() {
+    // Indexed draws give the index into the pool here
+    uint verticesPerInstance = meshVertices > 0 ? meshVertices : 3 * nrTriangles / (nrInstanceWidth * nrInstanceHeight * nrLayers);
+    Vertex v = vertices[gl_InstanceIndex * verticesPerInstance + gl_VertexIndex];
+
+    // [0 .. 1]
+    vec2 normalizedPos = mix(cellRect.xy, cellRect.zw, v.pos.xy);
+
+    // Per instance scissor, a triangle can never blend into a neighbouring cell
+    gl_ClipDistance[0] = normalizedPos.x - cellRect.x;
+    gl_ClipDistance[1] = cellRect.z - normalizedPos.x;
+    gl_ClipDistance[2] = normalizedPos.y - cellRect.y;
+    gl_ClipDistance[3] = cellRect.w - normalizedPos.y;
+
+    gl_Position = vec4(normalizedPos * 2 - 1, 0.0f, 1.0f);
+    uv = normalizedPos;
+    color = v.color;
+}
@@ -0,0 +1,58 @@
+// Operators shared by reduce.comp and scan.comp, keep in sync with include/Reduce.h.
+// Values are 32 bit and stored as raw bits, valueType decides how they are combined.
+#define REDUCE_OP_ADD 0
+#define REDUCE_OP_MIN 1
+#define REDUCE_OP_MAX 2
+#define REDUCE_TYPE_UINT 0
+#define REDUCE_TYPE_FLOAT 1
+
+// Every workgroup folds GROUP_SIZE * ITEMS_PER_INVOCATION values of one segment
+#define GROUP_SIZE 256
+#define ITEMS_PER_INVOCATION 4
+
+layout(constant_id = 0) const uint op = REDUCE_OP_ADD;
+layout(constant_id = 1) const uint valueType = REDUCE_TYPE_FLOAT;
+
+layout(push_constant) uniform PushConstants {
+    uint nrSegments;
+    uint segmentSize;
+    uint groupsPerSegment;
+} constants;
+
+uint identity() {
+    if (valueType == REDUCE_TYPE_FLOAT) {
+        if (op == REDUCE_OP_MIN) {
+            return 0x7F800000u;
+        }
+        if (op == REDUCE_OP_MAX) {
+            return 0xFF800000u;
+        }
+        return 0u;
+    }
+    return op == REDUCE_OP_MIN ? 0xFFFFFFFFu : 0u;
+}
+
+uint combine(uint a, uint b) {
+    if (valueType == REDUCE_TYPE_FLOAT) {
+        float fa = uintBitsToFloat(a);
+        float fb = uintBitsToFloat(b);
+        if (op == REDUCE_OP_ADD) {
+            return floatBitsToUint(fa + fb);
+        }
+        return floatBitsToUint(op == REDUCE_OP_MIN ? min(fa, fb) : max(fa, fb));
+    }
+    if (op == REDUCE_OP_ADD) {
+        return a + b;
+    }
+    return op == REDUCE_OP_MIN ? min(a, b) : max(a, b);
+}
+
+// Whether b is strictly smaller (min) or larger (max) than a
+bool replaces(uint a, uint b) {
+    if (valueType == REDUCE_TYPE_FLOAT) {
+        float fa = uintBitsToFloat(a);
+        float fb = uintBitsToFloat(b);
+        return op == REDUCE_OP_MIN ? fb < fa : fb > fa;
+    }
+    return op == REDUCE_OP_MIN ? b < a : b > a;
+}
@@ -0,0 +1,162 @@
+#include <Batch.h>
+#include <Primitives.h>
+#include <Dedup.h>
+#include <fstream>
+
+void _startJob(Ctx& ctx, Batch& batch, uint32_t slotIdx, Buffer* genome, Buffer* draws);
+void _emitResult(Ctx& ctx, Batch& batch, uint32_t slotIdx, uint32_t instance, Buffer& genome, Buffer* draws);
+
+Batch batchCreate(Ctx& ctx, BatchInfo& info) {
+    assert(info.goals->layers == info.nrSlots);
+    assert(info.plateau && info.plateau->nrGoals == info.nrSlots);
+    Batch ret{ .info = info };
+
+    std::ifstream file(info.manifestPath);
+    if (!file.is_open()) {
+        logger::crash(fmt::format("Could not open manifest {}", info.manifestPath));
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        ret.manifest.push_back(line);
+    }
+
+    if (ret.manifest.empty()) {
+        logger::crash(fmt::format("Manifest {} contains no goal images", info.manifestPath));
+    }
+    logger::info("Batch of {} goal images, {} at a time", ret.manifest.size(), info.nrSlots);
+    IngestInfo ingestInfo {
+        .paths = ret.manifest,
+        .width = info.goals->width,
+        .height = info.goals->height,
+        .format = info.goals->format,
+        .nrSlots = std::max(info.nrPrefetch, 1u),
+    };
+    ret.ingest = ingestCreate(ctx, ingestInfo);
+
+    // The initial genomes are already random
+    ret.slots.resize(info.nrSlots);
+    for (uint32_t i=0; i<info.nrSlots; i++) {
+        _startJob(ctx, ret, i, nullptr, nullptr);
+    }
+
+    return ret;
+}
+
+void batchDestroy(Ctx& ctx, Batch& batch) {
+    ingestDestroy(ctx, batch.ingest);
+}
+
+bool batchUpdate(Ctx& ctx, Batch& batch, const std::vector<PlateauState>& states) {
+    uint32_t frameIdx = ctx.frameCtx.frameIdx;
+    if (frameIdx == 0) {
+        // Nothing has been graded yet
+        return true;
+    }
+
+    // The scores of the previous frame belong to the genomes it rendered,
+    // those are still intact until this frame's evolve pass overwrites them.
+    ingestRetire(ctx, batch.ingest);
+    Buffer& graded = *batch.info.vertexBuffers[(frameIdx-1)%2];
+    Buffer& current = *batch.info.vertexBuffers[frameIdx%2];
+    Buffer* gradedDraws = nullptr;
+    Buffer* currentDraws = nullptr;
+    if (batch.info.drawBuffers[0]) {
+        gradedDraws = batch.info.drawBuffers[(frameIdx-1)%2];
+        currentDraws = batch.info.drawBuffers[frameIdx%2];
+    }
+
+    // A few words per slot instead of every score, a reset made here is uploaded before this frame runs
+    for (uint32_t s=0; s<batch.info.nrSlots; s++) {
+        auto& slot = batch.slots[s];
+        if (!slot.job.has_value()) {
+            continue;
+        }
+        const auto& state = states[s];
+        slot.generation = state.generations;
+        slot.bestFitness = plateauFitness(*batch.info.plateau, state.best);
+
+        if (state.status != PLATEAU_RUNNING) {
+            logger::info("Slot {} {}", s, plateauStatusName(state.status));
+            _emitResult(ctx, batch, s, state.bestInstance, graded, gradedDraws);
+            batch.finishedJobs++;
+            _startJob(ctx, batch, s, &current, currentDraws);
+        }
+    }
+
+    return batch.finishedJobs < batch.manifest.size();
+}
+
+void _startJob(Ctx& ctx, Batch& batch, uint32_t slotIdx, Buffer* genome, Buffer* draws) {
+    auto& slot = batch.slots[slotIdx];
+    slot.generation = 0;
+    slot.bestFitness = 0.0f;
+
+    if (batch.nextJob >= batch.manifest.size()) {
+        slot.job.reset();
+        return;
+    }
+
+    slot.job = batch.nextJob++;
+    plateauReset(ctx, *batch.info.plateau, slotIdx);
+    const auto& path = batch.manifest[slot.job.value()];
+    logger::info("Slot {} starts on {}", slotIdx, path);
+    // Jobs start in manifest order, the order they are decoded in
+    ingestUpload(ctx, batch.ingest, *batch.info.goals, slotIdx, VK_IMAGE_LAYOUT_GENERAL);
+
+    if (genome) {
+        const uint32_t nrVertices = 3 * batch.info.nrTrianglesPerInstance * batch.info.nrInstancesPerSlot;
+        auto vertexData = randomGenomes(batch.info.runSeed, slot.job.value(),
+                slotIdx * batch.info.nrInstancesPerSlot, batch.info.nrInstancesPerSlot, batch.info.nrTrianglesPerInstance);
+        buffertools::uploadBufferD(ctx, *genome, slotIdx * nrVertices * sizeof(Vertex),
+                nrVertices * sizeof(Vertex), vertexData.data());
+    }
+    if (draws) {
+        auto drawData = genomeDraws(slotIdx * batch.info.nrInstancesPerSlot, batch.info.nrInstancesPerSlot, batch.info.startTriangles);
+        buffertools::uploadBufferD(ctx, *draws, slotIdx * batch.info.nrInstancesPerSlot * sizeof(VkDrawIndirectCommand),
+                drawData.size() * sizeof(VkDrawIndirectCommand), drawData.data());
+    }
+    if (genome && batch.info.duplicates) {
+        // Drop the scores the old genomes passed on
+        const uint32_t first = slotIdx * batch.info.nrInstancesPerSlot;
+        std::vector<uint32_t> duplicates(batch.info.nrInstancesPerSlot, dedupNoDuplicate);
+        std::vector<float> scores(batch.info.nrInstancesPerSlot, 1.0f);
+        buffertools::uploadBufferD(ctx, *batch.info.duplicates, first * sizeof(uint32_t),
+                duplicates.size() * sizeof(uint32_t), duplicates.data());
+        buffertools::uploadBufferD(ctx, *batch.info.scoreBuffer, first * sizeof(float),
+                scores.size() * sizeof(float), scores.data());
+    }
+}
+
+void _emitResult(Ctx& ctx, Batch& batch, uint32_t slotIdx, uint32_t instance, Buffer& genome, Buffer* draws) {
+    const auto& slot = batch.slots[slotIdx];
+    const auto& path = batch.manifest[slot.job.value()];
+    const uint32_t slotVertices = 3 * batch.info.nrTrianglesPerInstance;
+
+    // Only the active triangles of a variable-length genome
+    uint32_t nrVertices = slotVertices;
+    if (draws) {
+        VkDrawIndirectCommand draw;
+        buffertools::downloadBufferD(ctx, *draws, instance * sizeof(VkDrawIndirectCommand), sizeof(draw), &draw);
+        nrVertices = draw.vertexCount;
+    }
+
+    std::vector<Vertex> vertexData(nrVertices);
+    buffertools::downloadBufferD(ctx, genome, instance * slotVertices * sizeof(Vertex),
+            nrVertices * sizeof(Vertex), vertexData.data());
+
+    // One vertex per line: x y r g b a
+    auto outPath = path + ".tri";
+    std::ofstream out(outPath);
+    out << "# fitness " << slot.bestFitness << " generations " << slot.generation << "\n";
+    for (const auto& v : vertexData) {
+        out << v.pos.x << " " << v.pos.y << " "
+            << v.color.r << " " << v.color.g << " " << v.color.b << " " << v.color.a << "\n";
+    }
+
+    logger::info("Finished {} ({}/{}): fitness {} after {} generations -> {}",
+            path, batch.finishedJobs+1, batch.manifest.size(), slot.bestFitness, slot.generation, outPath);
+}
@@ -22,6 +22,7 @@ Buffer createBufferH2D_Data(Ctx& ctx, VkBufferUsageFlags usage, size_t size, voi
 
 Buffer createBufferD(Ctx& ctx, VkBufferUsageFlags usage, size_t size) {
     auto bufferInfo = vks::initializers::bufferCreateInfo(usage, static_cast<VkDeviceSize>(size));
+    ctxShareWithTransferQueue(ctx, bufferInfo);
     VmaAllocationCreateInfo allocInfo { .usage = VMA_MEMORY_USAGE_GPU_ONLY };
     Buffer ret{};
     vkCheck(vmaCreateBuffer(ctx.allocator, &bufferInfo, &allocInfo, &ret.buffer, &ret.memory, nullptr));
@@ -29,16 +30,8 @@ Buffer createBufferD(Ctx& ctx, VkBufferUsageFlags usage, size_t size) {
 }
 
 Buffer createBufferD_Data(Ctx& ctx, VkBufferUsageFlags usage, size_t size, void* data) {
-    auto staging = createBufferH_Data(ctx, usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size, data);
     auto dst = createBufferD(ctx, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, size);
-
-    ctxSingleTimeCommand(ctx, [&](VkCommandBuffer cmdBuffer) {
-        VkBufferCopy copyRegion{};
-        copyRegion.size = static_cast<VkDeviceSize>(size);
-        vkCmdCopyBuffer(cmdBuffer, staging.buffer, dst.buffer, 1, &copyRegion);
-    });
-
-    buffertools::destroyBuffer(ctx, staging);
+    uploaderBuffer(ctx, ctx.uploader, dst, 0, size, data);
     return dst;
 }
 
@@ -60,8 +53,68 @@ Buffer createBufferH_Data(Ctx& ctx, VkBufferUsageFlags usage, size_t size, void*
     return ret;
 }
 
+void uploadBufferD(Ctx& ctx, Buffer& dst, size_t offset, size_t size, void* data) {
+    uploaderBuffer(ctx, ctx.uploader, dst, offset, size, data);
+}
+
+void downloadBufferD(Ctx& ctx, Buffer& src, size_t offset, size_t size, void* data) {
+    auto staging = createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT, size);
+
+    ctxSingleTimeCommand(ctx, [&](VkCommandBuffer cmdBuffer) {
+        VkBufferCopy copyRegion{};
+        copyRegion.srcOffset = static_cast<VkDeviceSize>(offset);
+        copyRegion.size = static_cast<VkDeviceSize>(size);
+        vkCmdCopyBuffer(cmdBuffer, src.buffer, staging.buffer, 1, &copyRegion);
+    });
+
+    void* data_src;
+    vkCheck(vmaMapMemory(ctx.allocator, staging.memory, &data_src));
+    vmaInvalidateAllocation(ctx.allocator, staging.memory, 0, size);
+    memcpy(data, data_src, size);
+    vmaUnmapMemory(ctx.allocator, staging.memory);
+
+    buffertools::destroyBuffer(ctx, staging);
+}
+
 void destroyBuffer(Ctx& ctx, Buffer& buffer) {
     vmaDestroyBuffer(ctx.allocator, buffer.buffer, buffer.memory);
 }
 
+std::vector<Buffer> createAliasedBuffersD(Ctx& ctx, const std::vector<std::pair<VkBufferUsageFlags, size_t>>& buffers) {
+    assert(!buffers.empty());
+    std::vector<Buffer> ret(buffers.size());
+
+    VkMemoryRequirements combined { .size = 0, .alignment = 1, .memoryTypeBits = ~0u };
+    for (size_t i=0; i<buffers.size(); i++) {
+        auto [usage, size] = buffers[i];
+        auto bufferInfo = vks::initializers::bufferCreateInfo(usage, static_cast<VkDeviceSize>(size));
+        vkCheck(vkCreateBuffer(ctx.device, &bufferInfo, nullptr, &ret[i].buffer));
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(ctx.device, ret[i].buffer, &requirements);
+        combined.size = std::max(combined.size, requirements.size);
+        combined.alignment = std::max(combined.alignment, requirements.alignment);
+        combined.memoryTypeBits &= requirements.memoryTypeBits;
+    }
+
+    VmaAllocationCreateInfo allocInfo { .pool = ctx.transientPool };
+    VmaAllocation memory;
+    vkCheck(vmaAllocateMemory(ctx.allocator, &combined, &allocInfo, &memory, nullptr));
+    for (auto& buffer : ret) {
+        buffer.memory = memory;
+        vkCheck(vmaBindBufferMemory(ctx.allocator, memory, buffer.buffer));
+    }
+    return ret;
+}
+
+void destroyAliasedBuffers(Ctx& ctx, std::vector<Buffer>& buffers) {
+    for (auto& buffer : buffers) {
+        vkDestroyBuffer(ctx.device, buffer.buffer, nullptr);
+    }
+    if (!buffers.empty()) {
+        vmaFreeMemory(ctx.allocator, buffers[0].memory);
+    }
+    buffers.clear();
+}
+
 }
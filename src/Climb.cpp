@@ -0,0 +1,140 @@
+#include <Climb.h>
+#include <Primitives.h>
+
+// Proposal of climb.comp, a uvec4 and a uint padded to the alignment of the uvec4
+constexpr size_t climbProposalSize = 32;
+
+void _climbBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer);
+
+Climb climbCreate(Ctx& ctx, ClimbInfo& info) {
+    assert(info.instanceWidth % 16 == 0 && info.instanceHeight % 16 == 0);
+    assert(info.nrCandidates > 0);
+    Climb ret{};
+    ret.info = info;
+
+    const uint32_t nrCandidates = info.nrInstances * info.nrCandidates;
+    const uint32_t tilesPerInstance = (info.instanceWidth / 16) * (info.instanceHeight / 16);
+    ret.candidates = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, nrCandidates * 3 * sizeof(Vertex));
+    ret.proposals = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, nrCandidates * climbProposalSize);
+    ret.tilePartials = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, size_t(nrCandidates) * tilesPerInstance * sizeof(float));
+    ret.chosen = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, info.nrInstances * sizeof(uint32_t));
+
+    auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ClimbArgs), 0);
+    CompInfo compInfo {
+        // compact goals need the variant that reads them without a format
+        .compShader = info.goal->format == VK_FORMAT_R32G32B32A32_SFLOAT ? "climb.comp" : "climb_unformatted.comp",
+        .bindingDescription = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        },
+        .pushConstantRange = &pushConstant,
+        .specializationConstants = {
+            info.nrInstances,
+            info.nrTrianglesPerInstance,
+            info.instanceWidth,
+            info.instanceHeight,
+            info.nrInstancesPerGoal,
+            info.nrCandidates,
+            0,
+        },
+    };
+    for (uint32_t pass=0; pass<4; pass++) {
+        compInfo.specializationConstants[6] = pass;
+        ret.pipelines[pass] = compCreate(ctx, compInfo);
+        for (uint32_t i=0; i<2; i++) {
+            CompResourceBindings bindings {
+                { 0, info.vertexBuffers[i]->buffer },
+                { 1, info.vertexBuffers[(i+1)%2]->buffer },
+                { 2, info.scoreBuffer->buffer },
+                { 3, info.goal->view },
+                { 4, ret.candidates.buffer },
+                { 5, ret.proposals.buffer },
+                { 6, ret.tilePartials.buffer },
+                { 7, ret.chosen.buffer },
+            };
+            ret.descriptorSets[pass][i] = compCreateDescriptorSet(ctx, ret.pipelines[pass], bindings);
+        }
+    }
+
+    return ret;
+}
+
+void climbDestroy(Ctx& ctx, Climb& climb) {
+    for (auto& pipeline : climb.pipelines) {
+        compDestroy(ctx, pipeline);
+    }
+    buffertools::destroyBuffer(ctx, climb.candidates);
+    buffertools::destroyBuffer(ctx, climb.proposals);
+    buffertools::destroyBuffer(ctx, climb.tilePartials);
+    buffertools::destroyBuffer(ctx, climb.chosen);
+}
+
+void climbRecord(Ctx& ctx, Climb& climb, ClimbArgs& args) {
+    const auto& info = climb.info;
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const uint32_t nrCandidates = info.nrInstances * info.nrCandidates;
+    const uint32_t nrVertices = 3 * info.nrTrianglesPerInstance * info.nrInstances;
+    const uint32_t groups[4][3] = {
+        { nrCandidates/256+1, 1, 1 },
+        { info.instanceWidth/16, info.instanceHeight/16, nrCandidates },
+        { info.nrInstances/256+1, 1, 1 },
+        { nrVertices/256+1, 1, 1 },
+    };
+
+    for (uint32_t pass=0; pass<4; pass++) {
+        if (pass > 0) {
+            _climbBarrier(ctx, cmdBuffer);
+        }
+        const auto& pipeline = climb.pipelines[pass];
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipelineLayout, 0, 1, &climb.descriptorSets[pass][frame], 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ClimbArgs), &args);
+        vkCmdDispatch(cmdBuffer, groups[pass][0], groups[pass][1], groups[pass][2]);
+    }
+}
+
+void climbAddPass(Ctx& ctx, RenderGraph& graph, Climb& climb, ClimbArgs args) {
+    const auto& info = climb.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto readWrite = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    // the barriers between the four dispatches stay inside the pass
+    renderGraphAddPass(graph, GraphPass {
+        .name = "climb",
+        .uses = {
+            { .buffer = info.vertexBuffers[frame]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR },
+            { .buffer = info.vertexBuffers[(frame+1)%2]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR },
+            { .buffer = info.scoreBuffer->buffer, .stage = stage, .access = readWrite },
+            { .image = info.goal, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_GENERAL },
+            { .buffer = climb.candidates.buffer, .stage = stage, .access = readWrite },
+            { .buffer = climb.proposals.buffer, .stage = stage, .access = readWrite },
+            { .buffer = climb.tilePartials.buffer, .stage = stage, .access = readWrite },
+            { .buffer = climb.chosen.buffer, .stage = stage, .access = readWrite },
+        },
+        .record = [&climb, args](Ctx& ctx) mutable { climbRecord(ctx, climb, args); },
+    });
+}
+
+// Private implementation
+void _climbBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer) {
+    VkMemoryBarrier2KHR barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+    };
+    VkDependencyInfoKHR dependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    ctx.cmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+}
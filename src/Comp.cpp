@@ -1,4 +1,5 @@
 #include <Comp.h>
+#include <Shaders.h>
 
 CompPipeline compCreate(const Ctx& ctx, const CompInfo& info) {
     CompPipeline ret{};
@@ -26,11 +27,15 @@ CompPipeline compCreate(const Ctx& ctx, const CompInfo& info) {
 
     vkCheck(vkCreatePipelineLayout(ctx.device, &layoutInfo, nullptr, &ret.pipelineLayout));
 
-    auto shader = vks::tools::loadShader(info.compShaderPath, ctx.device);
+    auto shader = shaders::createModule(ctx.device, info.compShader);
+
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    auto specialization = shaders::specializationInfo(info.specializationConstants, specializationEntries);
 
     auto pipelineInfo = vks::initializers::computePipelineCreateInfo(ret.pipelineLayout);
     pipelineInfo.stage = vks::initializers::pipelineShaderStageCreateInfo(shader, VK_SHADER_STAGE_COMPUTE_BIT);
-    vkCheck(vkCreateComputePipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &ret.pipeline));
+    pipelineInfo.stage.pSpecializationInfo = &specialization;
+    vkCheck(vkCreateComputePipelines(ctx.device, ctx.pipelineCache, 1, &pipelineInfo, nullptr, &ret.pipeline));
 
     vkDestroyShaderModule(ctx.device, shader, nullptr);
     return ret;
@@ -44,9 +49,7 @@ void compDestroy(const Ctx& ctx, const CompPipeline& comp) {
 
 VkDescriptorSet compCreateDescriptorSet(const Ctx& ctx, const CompPipeline& comp, const CompResourceBindings& bindings) {
     logger::debug("Creating descriptor set for compute shader");
-    VkDescriptorSet ret;
-    auto allocInfo = vks::initializers::descriptorSetAllocateInfo(ctx.descriptorPool, &comp.descriptorSetLayout, 1);
-    vkCheck(vkAllocateDescriptorSets(ctx.device, &allocInfo, &ret));
+    VkDescriptorSet ret = ctxAllocDescriptorSet(ctx, comp.descriptorSetLayout);
 
     for(const auto& binding : bindings) {
         auto descr = comp.bindingDescription.at(binding.first);
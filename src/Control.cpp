@@ -0,0 +1,281 @@
+#include <Control.h>
+#include <Primitives.h>
+#include <fstream>
+#include <sstream>
+#include <poll.h>
+#include <unistd.h>
+
+void _serve(ControlInfo info, ControlQueue* queue);
+std::string _execute(const ControlInfo& info, ControlQueue& queue, const std::string& line);
+uint32_t _verticesPerInstance(const ControlInfo& info);
+void _writeCheckpoint(Ctx& ctx, Control& control, const std::string& path);
+
+Control controlCreate(Ctx& ctx, ControlInfo& info) {
+    Control ret{ .info = info };
+    ret.genomeReadback = buffertools::createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            _verticesPerInstance(info) * info.nrInstances * sizeof(Vertex));
+    if (info.drawBuffers[0]) {
+        ret.drawReadback = buffertools::createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                info.nrInstances * sizeof(VkDrawIndirectCommand));
+    }
+    if (info.indexBuffers[0]) {
+        ret.indexReadback = buffertools::createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                3 * info.nrTrianglesPerInstance * info.nrInstances * sizeof(uint32_t));
+    }
+
+    ret.queue = std::make_unique<ControlQueue>();
+    ret.queue->listenSocket = socketListen(info.endpoint);
+    ret.queue->running = true;
+    // The queue lives on the heap, so the Control itself may still be moved
+    ret.queue->thread = std::thread(_serve, info, ret.queue.get());
+
+    if (info.endpoint.path) {
+        logger::info("Control on unix socket {}", info.endpoint.path);
+    } else {
+        logger::info("Control on localhost:{}", info.endpoint.port);
+    }
+    return ret;
+}
+
+void controlDestroy(Ctx& ctx, Control& control) {
+    auto& q = *control.queue;
+    q.running = false;
+    q.thread.join();
+    socketClose(q.listenSocket, control.info.endpoint);
+    buffertools::destroyBuffer(ctx, control.genomeReadback);
+    if (control.info.drawBuffers[0]) {
+        buffertools::destroyBuffer(ctx, control.drawReadback);
+    }
+    if (control.info.indexBuffers[0]) {
+        buffertools::destroyBuffer(ctx, control.indexReadback);
+    }
+}
+
+std::vector<ControlCommand> controlPoll(Ctx& ctx, Control& control) {
+    for (const auto& path : control.copiedCheckpoints) {
+        _writeCheckpoint(ctx, control, path);
+    }
+    control.copiedCheckpoints.clear();
+
+    std::lock_guard<std::mutex> lock(control.queue->mutex);
+    return std::exchange(control.queue->commands, {});
+}
+
+void controlAddPasses(Ctx& ctx, RenderGraph& graph, Control& control) {
+    {
+        std::lock_guard<std::mutex> lock(control.queue->mutex);
+        control.copiedCheckpoints = std::exchange(control.queue->checkpoints, {});
+    }
+    if (control.copiedCheckpoints.empty()) {
+        return;
+    }
+
+    // The genomes this frame renders and grades
+    const uint32_t frameIdx = ctx.frameCtx.frameIdx;
+    const auto& info = control.info;
+    control.copiedGeneration = frameIdx;
+    std::vector<std::tuple<Buffer*, Buffer*, size_t>> copies {
+        { info.vertexBuffers[frameIdx % 2], &control.genomeReadback, _verticesPerInstance(info) * info.nrInstances * sizeof(Vertex) },
+    };
+    if (info.drawBuffers[0]) {
+        copies.emplace_back(info.drawBuffers[frameIdx % 2], &control.drawReadback, info.nrInstances * sizeof(VkDrawIndirectCommand));
+    }
+    if (info.indexBuffers[0]) {
+        copies.emplace_back(info.indexBuffers[frameIdx % 2], &control.indexReadback,
+                3 * info.nrTrianglesPerInstance * info.nrInstances * sizeof(uint32_t));
+    }
+
+    GraphPass readback {
+        .name = "control_readback",
+        .record = [copies](Ctx& ctx) {
+            for (const auto& [src, dst, size] : copies) {
+                VkBufferCopy copyRegion{};
+                copyRegion.size = size;
+                vkCmdCopyBuffer(ctx.frameCtx.cmdBuffer, src->buffer, dst->buffer, 1, &copyRegion);
+            }
+        },
+    };
+    GraphPass hostRead {
+        .name = "control_host_read",
+        .record = [](Ctx&) {},
+    };
+    for (const auto& [src, dst, size] : copies) {
+        readback.uses.push_back({ .buffer = src->buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR });
+        readback.uses.push_back({ .buffer = dst->buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR });
+        hostRead.uses.push_back({ .buffer = dst->buffer, .stage = VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+                .access = VK_ACCESS_2_HOST_READ_BIT_KHR });
+    }
+    renderGraphAddPass(graph, readback);
+    // Records nothing, only makes the copies visible to the host after the frame fence
+    renderGraphAddPass(graph, hostRead);
+}
+
+// Private implementation
+
+void _serve(ControlInfo info, ControlQueue* queue) {
+    while (queue->running.load()) {
+        // Wakes up now and then to see whether it should stop
+        int client = socketAccept(queue->listenSocket, 100);
+        if (client < 0) {
+            continue;
+        }
+
+        // One client at a time, for as long as it stays connected
+        std::string pending;
+        pollfd readable { .fd = client, .events = POLLIN };
+        while (queue->running.load()) {
+            if (poll(&readable, 1, 100) <= 0) {
+                continue;
+            }
+            char data[1024];
+            ssize_t nrRead = read(client, data, sizeof(data));
+            if (nrRead <= 0) {
+                break;
+            }
+            pending.append(data, nrRead);
+
+            size_t end;
+            bool connected = true;
+            while (connected && (end = pending.find('\n')) != std::string::npos) {
+                std::string line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (line.empty()) {
+                    continue;
+                }
+                connected = socketSend(client, _execute(info, *queue, line) + "\n");
+            }
+            if (!connected) {
+                break;
+            }
+        }
+        close(client);
+    }
+}
+
+std::string _execute(const ControlInfo& info, ControlQueue& queue, const std::string& line) {
+    std::istringstream in(line);
+    std::string verb;
+    in >> verb;
+    ControlCommand command{};
+
+    if (verb == "set") {
+        if (!(in >> command.name >> command.value)) {
+            return "error: usage is set <parameter> <value>";
+        }
+        auto known = std::find_if(controlParameters.begin(), controlParameters.end(), [&](const char* parameter) {
+            return command.name == parameter;
+        });
+        if (known == controlParameters.end()) {
+            return fmt::format("error: unknown parameter {}", command.name);
+        }
+        command.type = CONTROL_SET;
+    } else if (verb == "goal") {
+        if (!info.goals) {
+            return "error: goal images cannot be replaced in this mode";
+        }
+        if (!(in >> command.name)) {
+            return "error: usage is goal <path> [layer]";
+        }
+        if (!(in >> command.layer)) {
+            command.layer = 0;
+        }
+        if (command.layer >= info.goals->layers) {
+            return fmt::format("error: there are {} goal layers", info.goals->layers);
+        }
+
+        // Decoded here so the loop only pays for the staging copy
+        int width, height, nrChannels;
+        float* pixels = stbi_loadf(command.name.c_str(), &width, &height, &nrChannels, STBI_rgb_alpha);
+        if (!pixels) {
+            return fmt::format("error: could not load {}", command.name);
+        }
+        if (width != info.goals->width || height != info.goals->height) {
+            stbi_image_free(pixels);
+            return fmt::format("error: {} is {}x{}, expected {}x{}", command.name, width, height,
+                    info.goals->width, info.goals->height);
+        }
+        command.pixels.assign(pixels, pixels + 4 * width * height);
+        stbi_image_free(pixels);
+        command.type = CONTROL_GOAL;
+    } else if (verb == "pause") {
+        command.type = CONTROL_PAUSE;
+    } else if (verb == "resume") {
+        command.type = CONTROL_RESUME;
+    } else if (verb == "checkpoint") {
+        std::string path;
+        if (!(in >> path)) {
+            return "error: usage is checkpoint <path>";
+        }
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.checkpoints.push_back(path);
+        return "ok";
+    } else {
+        return fmt::format("error: unknown command {}", verb);
+    }
+
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.commands.push_back(std::move(command));
+    return "ok";
+}
+
+uint32_t _verticesPerInstance(const ControlInfo& info) {
+    return info.indexBuffers[0] ? info.meshVertices : 3 * info.nrTrianglesPerInstance;
+}
+
+void _writeCheckpoint(Ctx& ctx, Control& control, const std::string& path) {
+    const uint32_t slotVertices = _verticesPerInstance(control.info);
+    const size_t genomeSize = slotVertices * control.info.nrInstances * sizeof(Vertex);
+    std::vector<Vertex> vertexData(slotVertices * control.info.nrInstances);
+    void* data;
+    vkCheck(vmaMapMemory(ctx.allocator, control.genomeReadback.memory, &data));
+    vmaInvalidateAllocation(ctx.allocator, control.genomeReadback.memory, 0, genomeSize);
+    memcpy(vertexData.data(), data, genomeSize);
+    vmaUnmapMemory(ctx.allocator, control.genomeReadback.memory);
+
+    std::vector<VkDrawIndirectCommand> draws;
+    if (control.info.drawBuffers[0]) {
+        const size_t drawsSize = control.info.nrInstances * sizeof(VkDrawIndirectCommand);
+        draws.resize(control.info.nrInstances);
+        vkCheck(vmaMapMemory(ctx.allocator, control.drawReadback.memory, &data));
+        vmaInvalidateAllocation(ctx.allocator, control.drawReadback.memory, 0, drawsSize);
+        memcpy(draws.data(), data, drawsSize);
+        vmaUnmapMemory(ctx.allocator, control.drawReadback.memory);
+    }
+    std::vector<uint32_t> indices;
+    if (control.info.indexBuffers[0]) {
+        indices.resize(3 * control.info.nrTrianglesPerInstance * control.info.nrInstances);
+        const size_t indicesSize = indices.size() * sizeof(uint32_t);
+        vkCheck(vmaMapMemory(ctx.allocator, control.indexReadback.memory, &data));
+        vmaInvalidateAllocation(ctx.allocator, control.indexReadback.memory, 0, indicesSize);
+        memcpy(indices.data(), data, indicesSize);
+        vmaUnmapMemory(ctx.allocator, control.indexReadback.memory);
+    }
+
+    // Every instance like a .tri of the batch mode, one vertex per line: x y r g b a
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        logger::error("Could not write checkpoint {}", path);
+        return;
+    }
+    out << "# checkpoint generation " << control.copiedGeneration << "\n";
+    for (uint32_t instance=0; instance<control.info.nrInstances; instance++) {
+        // Only the active triangles of a variable-length genome, meshes are written out as triangles
+        uint32_t nrVertices = draws.empty() ? slotVertices : draws[instance].vertexCount;
+        if (!indices.empty()) {
+            nrVertices = 3 * control.info.nrTrianglesPerInstance;
+        }
+        out << "# instance " << instance << "\n";
+        for (uint32_t i=0; i<nrVertices; i++) {
+            const uint32_t vertex = indices.empty() ? i : indices[instance * nrVertices + i];
+            const auto& v = vertexData[instance * slotVertices + vertex];
+            out << v.pos.x << " " << v.pos.y << " "
+                << v.color.r << " " << v.color.g << " " << v.color.b << " " << v.color.a << "\n";
+        }
+    }
+    logger::info("Checkpoint of generation {} -> {}", control.copiedGeneration, path);
+}
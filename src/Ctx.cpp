@@ -1,4 +1,6 @@
 #include "Ctx.h"
+#include <fstream>
+#include <mutex>
 
 #ifdef NDEBUG
 const bool enableValidation = false;
@@ -11,8 +13,24 @@ struct QueueFamilies {
     uint32_t compute;
     uint32_t graphics;
     uint32_t present;
+    uint32_t transfer;
 };
 
+// Prefixed to the cache data on disk, a cache from another device or driver is ignored
+struct PipelineCacheHeader {
+    uint32_t magic;
+    uint32_t driverVersion;
+    uint8_t uuid[VK_UUID_SIZE];
+    uint64_t dataSize;
+};
+const uint32_t pipelineCacheMagic = 0x4c495341;
+
+std::mutex descriptorPoolMutex;
+// The pipelines are built on worker threads, their uploads share the command pool and the queue
+std::mutex singleTimeCommandMutex;
+// Queues are externally synchronized, the uploader and the presenter submit from their own threads
+std::mutex queueMutex;
+
 struct SwapchainSupport {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -29,12 +47,14 @@ void _initSwapchain(Ctx&);
 void _initSyncObjects(Ctx&);
 void _initCommandPool(Ctx&);
 void _initDescriptorPool(Ctx& ctx);
+void _initPipelineCache(Ctx& ctx);
+void _savePipelineCache(Ctx& ctx);
 
 
 QueueFamilies _queryQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 SwapchainSupport _querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
 VkSurfaceFormatKHR _chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& formats);
-VkPresentModeKHR _choosePresentMode(const std::vector<VkPresentModeKHR>& modes);
+VkPresentModeKHR _choosePresentMode(const std::vector<VkPresentModeKHR>& modes, VkPresentModeKHR preferred);
 VkExtent2D _chooseSwapchainExtent(GLFWwindow* window, const VkSurfaceCapabilitiesKHR& capabilities);
 
 void glfwErrorCallback(int error, const char* description) {
@@ -48,23 +68,40 @@ Ctx ctxCreate(CtxInfo& info) {
         .info = info,
         .state = CTX_STATE_APP_START, 
     };
-    _initWindow(ctx);
+    if (!info.headless) {
+        _initWindow(ctx);
+    }
     _initInstance(ctx);
-    _initSurface(ctx);
+    if (!info.headless) {
+        _initSurface(ctx);
+    }
     _initPhysicalDevice(ctx);
     _initDevice(ctx);
     _initAllocator(ctx);
-    _initSwapchain(ctx);
+    if (!info.headless) {
+        _initSwapchain(ctx);
+    } else {
+        // The viewport of rasterization pipelines is taken from the window size
+        ctx.window.width = info.windowWidth;
+        ctx.window.height = info.windowHeight;
+        ctx.window.imageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+    }
     _initSyncObjects(ctx);
     _initCommandPool(ctx);
+    ctx.uploader = uploaderCreate(ctx, info.stagingRingSize);
     _initDescriptorPool(ctx);
+    _initPipelineCache(ctx);
     return ctx;
 }
 
 void ctxDestroy(Ctx& ctx) {
     assert(ctx.state == CTX_STATE_FINISHED && "Call finish before destroying the ctx");
     logger::debug("cleaning up");
+    _savePipelineCache(ctx);
+    vkDestroyPipelineCache(ctx.device, ctx.pipelineCache, nullptr);
     vkDestroyDescriptorPool(ctx.device, ctx.descriptorPool, nullptr);
+    uploaderDestroy(ctx, ctx.uploader);
+    vmaDestroyPool(ctx.allocator, ctx.transientPool);
     vmaDestroyAllocator(ctx.allocator);
     vkDestroyCommandPool(ctx.device, ctx.commandPool, nullptr);
 
@@ -74,15 +111,24 @@ void ctxDestroy(Ctx& ctx) {
     for (auto image : ctx.window.swapchainImages) {
         vkDestroyImageView(ctx.device, image.view, nullptr);
     }
-    vkDestroySwapchainKHR(ctx.device, ctx.window.swapchain, nullptr);
+    if (!ctx.info.headless) {
+        vkDestroySwapchainKHR(ctx.device, ctx.window.swapchain, nullptr);
+    }
     vkDestroyDevice(ctx.device, nullptr);
-    vkDestroySurfaceKHR(ctx.instance, ctx.window.surface, nullptr);
+    if (!ctx.info.headless) {
+        vkDestroySurfaceKHR(ctx.instance, ctx.window.surface, nullptr);
+    }
     vkDestroyInstance(ctx.instance, nullptr);
-    glfwDestroyWindow(ctx.window.glfwWindow);
-    glfwTerminate();
+    if (!ctx.info.headless) {
+        glfwDestroyWindow(ctx.window.glfwWindow);
+        glfwTerminate();
+    }
 }
 
 bool ctxWindowShouldClose(Ctx& ctx) {
+    if (ctx.info.headless) {
+        return false;
+    }
     return glfwWindowShouldClose(ctx.window.glfwWindow);
 }
 
@@ -91,13 +137,17 @@ FrameCtx& ctxBeginFrame(Ctx& ctx) {
     vkResetFences(ctx.device, 1, &ctx.inFlightFence);
     assert(ctx.state == CTX_STATE_APP_START || ctx.state == CTX_STATE_FRAME_SUBMITTED);
     ctx.state = CTX_STATE_FRAME_STARTED;
-    glfwPollEvents();
 
-    ctx.frameCtx.swapchainImage = ctx.window.swapchainImages[0];
     ctx.frameCtx.cmdBuffer = ctx.cmdBuffer;
     ctx.frameCtx.frameIdx++;
 
-    vkAcquireNextImageKHR(ctx.device, ctx.window.swapchain, UINT64_MAX, ctx.imageAvailable, VK_NULL_HANDLE, &ctx.frameCtx.imageIdx);
+    if (!ctx.info.headless) {
+        glfwPollEvents();
+    }
+    if (!ctx.info.headless && !ctx.info.detachedPresent) {
+        ctx.frameCtx.swapchainImage = ctx.window.swapchainImages[0];
+        vkAcquireNextImageKHR(ctx.device, ctx.window.swapchain, UINT64_MAX, ctx.imageAvailable, VK_NULL_HANDLE, &ctx.frameCtx.imageIdx);
+    }
 
     vkCheck(vkResetCommandBuffer(ctx.frameCtx.cmdBuffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT));
     return ctx.frameCtx;
@@ -105,16 +155,42 @@ FrameCtx& ctxBeginFrame(Ctx& ctx) {
 
 void ctxEndFrame(Ctx& ctx, VkCommandBuffer cmdBuffer) {
     assert(ctx.state == CTX_STATE_FRAME_STARTED);
-    ctx.state = CTX_STATE_FRAME_SUBMITTED;
 
+    // Uploads made since the last frame go out now, the frame waits for them on the GPU only
+    auto& frame = ctx.frameCtx;
+    ctxFrameWait(ctx, ctx.uploader.timeline, uploaderFlush(ctx, ctx.uploader), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    const bool present = !ctx.info.headless && !ctx.info.detachedPresent;
+    if (present) {
+        // the value is ignored for binary semaphores
+        ctxFrameWait(ctx, ctx.imageAvailable, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        ctxFrameSignal(ctx, ctx.renderFinished, 0);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = static_cast<uint32_t>(frame.waitValues.size()),
+        .pWaitSemaphoreValues = frame.waitValues.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>(frame.signalValues.size()),
+        .pSignalSemaphoreValues = frame.signalValues.data(),
+    };
     auto submitInfo = vks::initializers::submitInfo(&cmdBuffer);
-    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &ctx.imageAvailable;
-    submitInfo.pWaitDstStageMask = &waitStage;
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &ctx.renderFinished;
-    vkCheck(vkQueueSubmit(ctx.queues.graphics, 1, &submitInfo, ctx.inFlightFence));
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = frame.waitSemaphores.size();
+    submitInfo.pWaitSemaphores = frame.waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = frame.waitStages.data();
+    submitInfo.signalSemaphoreCount = frame.signalSemaphores.size();
+    submitInfo.pSignalSemaphores = frame.signalSemaphores.data();
+    ctxQueueSubmit(ctx, ctx.queues.graphics, submitInfo, ctx.inFlightFence);
+    ctx.state = CTX_STATE_FRAME_SUBMITTED;
+
+    frame.waitSemaphores.clear();
+    frame.waitStages.clear();
+    frame.waitValues.clear();
+    frame.signalSemaphores.clear();
+    frame.signalValues.clear();
+    if (!present) {
+        return;
+    }
 
     VkPresentInfoKHR presentInfo {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -125,7 +201,30 @@ void ctxEndFrame(Ctx& ctx, VkCommandBuffer cmdBuffer) {
         .pImageIndices = &ctx.frameCtx.imageIdx,
     };
 
-    vkCheck(vkQueuePresentKHR(ctx.queues.present, &presentInfo));
+    vkCheck(ctxQueuePresent(ctx, presentInfo));
+}
+
+void ctxFrameWait(Ctx& ctx, VkSemaphore semaphore, uint64_t value, VkPipelineStageFlags stage) {
+    assert(ctx.state == CTX_STATE_FRAME_STARTED);
+    ctx.frameCtx.waitSemaphores.push_back(semaphore);
+    ctx.frameCtx.waitStages.push_back(stage);
+    ctx.frameCtx.waitValues.push_back(value);
+}
+
+void ctxFrameSignal(Ctx& ctx, VkSemaphore semaphore, uint64_t value) {
+    assert(ctx.state == CTX_STATE_FRAME_STARTED);
+    ctx.frameCtx.signalSemaphores.push_back(semaphore);
+    ctx.frameCtx.signalValues.push_back(value);
+}
+
+void ctxQueueSubmit(const Ctx& ctx, VkQueue queue, const VkSubmitInfo& submitInfo, VkFence fence) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    vkCheck(vkQueueSubmit(queue, 1, &submitInfo, fence));
+}
+
+VkResult ctxQueuePresent(const Ctx& ctx, const VkPresentInfoKHR& presentInfo) {
+    std::lock_guard<std::mutex> lock(queueMutex);
+    return vkQueuePresentKHR(ctx.queues.present, &presentInfo);
 }
 
 VkCommandBuffer ctxAllocCmdBuffer(Ctx& ctx) {
@@ -136,6 +235,10 @@ VkCommandBuffer ctxAllocCmdBuffer(Ctx& ctx) {
 }
 
 void ctxSingleTimeCommand(Ctx& ctx, std::function<void(VkCommandBuffer)> f) {
+    // Blocking anyway, so the commands may rely on everything uploaded before
+    uploaderWait(ctx, ctx.uploader, uploaderFlush(ctx, ctx.uploader));
+
+    std::lock_guard<std::mutex> lock(singleTimeCommandMutex);
     auto cmdBuffer = ctxAllocCmdBuffer(ctx);
     auto beginInfo = vks::initializers::commandBufferBeginInfo();
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
@@ -143,13 +246,25 @@ void ctxSingleTimeCommand(Ctx& ctx, std::function<void(VkCommandBuffer)> f) {
     f(cmdBuffer);
     vkCheck(vkEndCommandBuffer(cmdBuffer));
 
+    // A fence instead of vkQueueWaitIdle, the queue may be shared with the presenter thread
+    VkFence fence;
+    auto fenceInfo = vks::initializers::fenceCreateInfo();
+    vkCheck(vkCreateFence(ctx.device, &fenceInfo, nullptr, &fence));
     auto submitInfo = vks::initializers::submitInfo(&cmdBuffer);
-    vkQueueSubmit(ctx.queues.graphics, 1, &submitInfo, VK_NULL_HANDLE);
+    ctxQueueSubmit(ctx, ctx.queues.graphics, submitInfo, fence);
+    vkCheck(vkWaitForFences(ctx.device, 1, &fence, VK_TRUE, UINT64_MAX));
+    vkDestroyFence(ctx.device, fence, nullptr);
 
-    vkCheck(vkQueueWaitIdle(ctx.queues.graphics));
     vkFreeCommandBuffers(ctx.device, ctx.commandPool, 1, &cmdBuffer);
 }
 
+VkDescriptorSet ctxAllocDescriptorSet(const Ctx& ctx, VkDescriptorSetLayout layout) {
+    std::lock_guard<std::mutex> lock(descriptorPoolMutex);
+    VkDescriptorSet ret;
+    auto allocInfo = vks::initializers::descriptorSetAllocateInfo(ctx.descriptorPool, &layout, 1);
+    vkCheck(vkAllocateDescriptorSets(ctx.device, &allocInfo, &ret));
+    return ret;
+}
 
 void ctxFinish(Ctx& ctx) {
     logger::debug("Flushing all GPU commands in preperation of shutdown");
@@ -157,6 +272,31 @@ void ctxFinish(Ctx& ctx) {
     ctx.state = CTX_STATE_FINISHED;
 }
 
+void ctxLogMemoryReport(const Ctx& ctx) {
+    constexpr double MiB = 1024.0 * 1024.0;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(ctx.physicalDevice, &memoryProperties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetBudget(ctx.allocator, budgets);
+
+    for (uint32_t heap=0; heap<memoryProperties.memoryHeapCount; heap++) {
+        const auto& budget = budgets[heap];
+        if (budget.blockBytes == 0) {
+            continue;
+        }
+        bool deviceLocal = memoryProperties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        logger::info("Heap {} ({}): {:.1f} MiB allocated in {:.1f} MiB of blocks, usage {:.1f} of {:.1f} MiB budget{}",
+                heap, deviceLocal ? "device" : "host",
+                budget.allocationBytes / MiB, budget.blockBytes / MiB, budget.usage / MiB, budget.budget / MiB,
+                ctx.memoryBudget ? "" : " (estimated)");
+    }
+
+    VmaPoolStats poolStats;
+    vmaGetPoolStats(ctx.allocator, ctx.transientPool, &poolStats);
+    logger::info("Transient pool: {:.1f} MiB in {} blocks, {} allocations",
+            poolStats.size / MiB, poolStats.blockCount, poolStats.allocationCount);
+}
+
 // Private implementation
 void _initInstance(Ctx& ctx) {
     auto appInfo = vks::initializers::applicationInfo(VK_MAKE_VERSION(1,2,0));
@@ -171,10 +311,12 @@ void _initInstance(Ctx& ctx) {
 
     auto createInfo = vks::initializers::instanceInfo(&appInfo, validationLayers, extensions);
 
-    uint32_t glfwExtensionCount;
-    auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-    for(uint32_t i=0; i<glfwExtensionCount; i++) {
-        extensions.push_back(glfwExtensions[i]);
+    if (!ctx.info.headless) {
+        uint32_t glfwExtensionCount;
+        auto glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+        for(uint32_t i=0; i<glfwExtensionCount; i++) {
+            extensions.push_back(glfwExtensions[i]);
+        }
     }
 
     createInfo.enabledExtensionCount = extensions.size();
@@ -239,6 +381,7 @@ void _initDevice(Ctx& ctx) {
         indices.compute,
         indices.graphics,
         indices.present,
+        indices.transfer,
     };
 
     float priority = 1.0f;
@@ -249,19 +392,58 @@ void _initDevice(Ctx& ctx) {
     };
 
     std::vector<const char*> deviceExtensions = ctx.info.deviceExtensions;
-    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    deviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+    uint32_t extensionCount;
+    vkEnumerateDeviceExtensionProperties(ctx.physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(ctx.physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    for (const auto& ext : availableExtensions) {
+        if (strcmp(ext.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+            ctx.memoryBudget = true;
+        }
+    }
+    if (!ctx.info.headless) {
+        deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
 
     for(auto ext : deviceExtensions) {
         logger::info("Enabling device extension: {}", ext);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(ctx.physicalDevice, &supportedFeatures);
+    ctx.pipelineStatistics = supportedFeatures.pipelineStatisticsQuery;
+    if (ctx.info.storageImageReadWithoutFormat && !supportedFeatures.shaderStorageImageReadWithoutFormat) {
+        logger::crash("The device cannot read storage images without a format, which compact goal formats need");
+    }
+
     VkPhysicalDeviceFeatures deviceFeatures{ 
+        // one indirect draw per instance of the variable-length genomes
+        .multiDrawIndirect = VK_TRUE,
+        .drawIndirectFirstInstance = VK_TRUE,
         .fillModeNonSolid = VK_TRUE,
+        // optional, only the profiler uses it
+        .pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery,
+        // only for goal images in compact formats
+        .shaderStorageImageReadWithoutFormat = ctx.info.storageImageReadWithoutFormat,
+        .shaderClipDistance = VK_TRUE,
     };
 
     // extra features
+    VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineFeatures {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .timelineSemaphore = VK_TRUE,
+    };
+    VkPhysicalDeviceSynchronization2FeaturesKHR enabledSync2Features {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR,
+        .pNext = &enabledTimelineFeatures,
+        .synchronization2 = VK_TRUE,
+    };
     VkPhysicalDeviceShaderAtomicFloatFeaturesEXT enabledAtomicsFeatures {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_ATOMIC_FLOAT_FEATURES_EXT,
+        .pNext = &enabledSync2Features,
         .shaderBufferFloat32AtomicAdd = VK_TRUE,
     };
 
@@ -273,13 +455,26 @@ void _initDevice(Ctx& ctx) {
     vkGetDeviceQueue(ctx.device, indices.compute, 0, &ctx.queues.compute);
     vkGetDeviceQueue(ctx.device, indices.graphics, 0, &ctx.queues.graphics);
     vkGetDeviceQueue(ctx.device, indices.present, 0, &ctx.queues.present);
+    vkGetDeviceQueue(ctx.device, indices.transfer, 0, &ctx.queues.transfer);
+    ctx.queues.computeFamily = indices.compute;
+    ctx.queues.graphicsFamily = indices.graphics;
+    ctx.queues.presentFamily = indices.present;
+    ctx.queues.transferFamily = indices.transfer;
+    ctx.queues.sharedFamilies = { indices.graphics, indices.transfer };
+
+    ctx.cmdPipelineBarrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(
+            vkGetDeviceProcAddr(ctx.device, "vkCmdPipelineBarrier2KHR"));
+    if (!ctx.cmdPipelineBarrier2) {
+        logger::crash("VK_KHR_synchronization2 is required");
+    }
 
     logger::debug("Created logical device");
 }
 
 void _initAllocator(Ctx& ctx) {
     VmaAllocatorCreateInfo createInfo {
-        .flags = VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT,
+        .flags = VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT
+            | (ctx.memoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u),
         .physicalDevice = ctx.physicalDevice,
         .device = ctx.device,
         .instance = ctx.instance,
@@ -287,12 +482,20 @@ void _initAllocator(Ctx& ctx) {
     };
     vmaCreateAllocator(&createInfo, &ctx.allocator);
     logger::debug("created VMA allocator");
+
+    auto sampleBufferInfo = vks::initializers::bufferCreateInfo(
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT
+            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 1024);
+    VmaAllocationCreateInfo allocInfo { .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+    VmaPoolCreateInfo poolInfo{};
+    vkCheck(vmaFindMemoryTypeIndexForBufferInfo(ctx.allocator, &sampleBufferInfo, &allocInfo, &poolInfo.memoryTypeIndex));
+    vkCheck(vmaCreatePool(ctx.allocator, &poolInfo, &ctx.transientPool));
 }
 
 void _initSwapchain(Ctx& ctx) {
     auto support = _querySwapchainSupport(ctx.physicalDevice, ctx.window.surface);
     auto format = _chooseSurfaceFormat(support.formats);
-    auto mode = _choosePresentMode(support.presentModes);
+    auto mode = _choosePresentMode(support.presentModes, ctx.info.presentMode);
     auto extent = _chooseSwapchainExtent(ctx.window.glfwWindow, support.capabilities);
     ctx.window.imageFormat = format.format;
     ctx.window.width = extent.width;
@@ -392,9 +595,70 @@ void _initDescriptorPool(Ctx& ctx) {
     vkCheck(vkCreateDescriptorPool(ctx.device, &poolInfo, nullptr, &ctx.descriptorPool));
 }
 
+void _initPipelineCache(Ctx& ctx) {
+    std::vector<char> data;
+
+    if (ctx.info.pipelineCachePath) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(ctx.physicalDevice, &properties);
+
+        std::ifstream file(ctx.info.pipelineCachePath, std::ios::binary);
+        PipelineCacheHeader header{};
+        if (file.is_open() && file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+            if (header.magic == pipelineCacheMagic
+                    && header.driverVersion == properties.driverVersion
+                    && memcmp(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0) {
+                data.resize(header.dataSize);
+                if (!file.read(data.data(), data.size())) {
+                    data.clear();
+                }
+            } else {
+                logger::info("Ignoring pipeline cache {} from a different device or driver", ctx.info.pipelineCachePath);
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = data.size(),
+        .pInitialData = data.empty() ? nullptr : data.data(),
+    };
+    vkCheck(vkCreatePipelineCache(ctx.device, &createInfo, nullptr, &ctx.pipelineCache));
+    logger::debug("created pipeline cache with {} bytes of initial data", data.size());
+}
+
+void _savePipelineCache(Ctx& ctx) {
+    if (!ctx.info.pipelineCachePath) {
+        return;
+    }
+
+    size_t size;
+    vkCheck(vkGetPipelineCacheData(ctx.device, ctx.pipelineCache, &size, nullptr));
+    std::vector<char> data(size);
+    vkCheck(vkGetPipelineCacheData(ctx.device, ctx.pipelineCache, &size, data.data()));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &properties);
+    PipelineCacheHeader header {
+        .magic = pipelineCacheMagic,
+        .driverVersion = properties.driverVersion,
+        .dataSize = size,
+    };
+    memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::ofstream file(ctx.info.pipelineCachePath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        logger::error("Could not write pipeline cache {}", ctx.info.pipelineCachePath);
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(data.data(), size);
+    logger::debug("saved {} bytes of pipeline cache", size);
+}
+
 QueueFamilies _queryQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
     QueueFamilies indices{};
-    std::optional<uint32_t> compute, graphics, present;
+    std::optional<uint32_t> compute, graphics, present, transfer;
 
     uint32_t familyCount = 0;
     vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
@@ -412,8 +676,19 @@ QueueFamilies _queryQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
             graphics = i;
         }
 
-        VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        // Dedicated transfer families are the DMA engines, they copy while the graphics queue renders
+        bool transferOnly = (family.queueFlags & VK_QUEUE_TRANSFER_BIT)
+            && !(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+        if (!transfer.has_value() && transferOnly) {
+            logger::debug("transfer queue family index: {}", i);
+            transfer = i;
+        }
+
+        // Without a surface (headless) any graphics queue will do
+        VkBool32 presentSupport = family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        }
         if (!present.has_value() && presentSupport) {
             logger::debug("present queue family index: {}", i);
             present = i;
@@ -429,6 +704,7 @@ QueueFamilies _queryQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface)
     indices.compute = compute.value();
     indices.graphics = graphics.value();
     indices.present = present.value();
+    indices.transfer = transfer.value_or(indices.graphics);
     return indices;
 }
 
@@ -444,7 +720,7 @@ SwapchainSupport _querySwapchainSupport(VkPhysicalDevice device, VkSurfaceKHR su
 
     uint32_t presentCount;
     vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentCount, nullptr);
-    support.presentModes.reserve(presentCount);
+    support.presentModes.resize(presentCount);
     vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentCount, support.presentModes.data());
 
     return support;
@@ -460,11 +736,11 @@ VkSurfaceFormatKHR _chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& f
     return formats[0];
 }
 
-VkPresentModeKHR _choosePresentMode(const std::vector<VkPresentModeKHR>& modes) {
-    // Force no vsync
-    return VK_PRESENT_MODE_IMMEDIATE_KHR;
-    for (const auto& mode : modes) {
-        if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+VkPresentModeKHR _choosePresentMode(const std::vector<VkPresentModeKHR>& modes, VkPresentModeKHR preferred) {
+    // Neither mailbox nor immediate blocks on vsync, FIFO is the only mode that is always there
+    for (auto mode : { preferred, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }) {
+        if (std::find(modes.begin(), modes.end(), mode) != modes.end()) {
+            logger::debug("present mode {}", static_cast<int>(mode));
             return mode;
         }
     }
@@ -0,0 +1,71 @@
+#include <Cull.h>
+
+Cull cullCreate(Ctx& ctx, CullInfo& info) {
+    Cull ret{};
+    ret.info = info;
+    const bool variableLength = info.drawBuffers[0] != nullptr;
+
+    auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(CullArgs), 0);
+    CompInfo compInfo {
+        .compShader = "cull.comp",
+        .bindingDescription = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        },
+        .pushConstantRange = &pushConstant,
+        .specializationConstants = { info.nrTrianglesPerInstance, info.instanceWidth, info.instanceHeight, variableLength },
+    };
+    ret.pipeline = compCreate(ctx, compInfo);
+
+    for (uint32_t i=0; i<2; i++) {
+        CompResourceBindings bindings {
+            { 0, info.vertexBuffers[i]->buffer },
+            // only has to be valid for fixed length genomes
+            { 1, variableLength ? info.drawBuffers[i]->buffer : info.vertexBuffers[i]->buffer },
+            { 2, info.culledVertices->buffer },
+            { 3, info.culledDraws->buffer },
+        };
+        ret.descriptorSets[i] = compCreateDescriptorSet(ctx, ret.pipeline, bindings);
+    }
+
+    return ret;
+}
+
+void cullDestroy(Ctx& ctx, Cull& cull) {
+    compDestroy(ctx, cull.pipeline);
+}
+
+void cullRecord(Ctx& ctx, Cull& cull) {
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    CullArgs args {
+        .minArea = cull.info.minArea,
+        .minAlpha = cull.info.minAlpha,
+    };
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull.pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull.pipeline.pipelineLayout, 0, 1, &cull.descriptorSets[ctx.frameCtx.frameIdx%2], 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, cull.pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullArgs), &args);
+    vkCmdDispatch(cmdBuffer, cull.info.nrInstances, 1, 1);
+}
+
+void cullAddPass(Ctx& ctx, RenderGraph& graph, Cull& cull) {
+    const auto& info = cull.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto read = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+    const auto write = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    GraphPass pass {
+        .name = "cull",
+        .uses = {
+            { .buffer = info.vertexBuffers[frame]->buffer, .stage = stage, .access = read },
+            { .buffer = info.culledVertices->buffer, .stage = stage, .access = write },
+            { .buffer = info.culledDraws->buffer, .stage = stage, .access = write },
+        },
+        .record = [&cull](Ctx& ctx) { cullRecord(ctx, cull); },
+    };
+    if (info.drawBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.drawBuffers[frame]->buffer, .stage = stage, .access = read });
+    }
+    renderGraphAddPass(graph, pass);
+}
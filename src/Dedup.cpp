@@ -0,0 +1,157 @@
+#include <Dedup.h>
+
+Dedup dedupCreate(Ctx& ctx, DedupInfo& info) {
+    Dedup ret{};
+    ret.info = info;
+
+    CompInfo compInfo {
+        .compShader = "dedup.comp",
+        .bindingDescription = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        },
+        .specializationConstants = { info.nrTrianglesPerInstance },
+    };
+    ret.pipeline = compCreate(ctx, compInfo);
+
+    // No genome hashes to zero until the first children are hashed
+    std::vector<glm::uvec2> hashes(info.nrInstances, glm::uvec2(0));
+    for (auto& buffer : ret.hashes) {
+        buffer = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                hashes.size() * sizeof(glm::uvec2), hashes.data());
+    }
+    ret.scoreCache = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            info.nrInstances * sizeof(float));
+    uint32_t zero = 0;
+    ret.counter = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            sizeof(uint32_t), &zero);
+    ret.counterReadback = buffertools::createBufferH_Data(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT, sizeof(uint32_t), &zero);
+
+    // Set i is used by the frames that evolve from vertexBuffers[i] into the other one
+    for (uint32_t i=0; i<2; i++) {
+        uint32_t child = (i+1)%2;
+        CompResourceBindings bindings {
+            { 0, info.vertexBuffers[child]->buffer },
+            { 1, info.drawBuffers[child]->buffer },
+            { 2, info.parentBuffer->buffer },
+            { 3, ret.hashes[i].buffer },
+            { 4, ret.hashes[child].buffer },
+            { 5, info.duplicates->buffer },
+            { 6, info.scoreBuffer->buffer },
+            { 7, ret.scoreCache.buffer },
+            { 8, ret.counter.buffer },
+        };
+        ret.descriptorSets[i] = compCreateDescriptorSet(ctx, ret.pipeline, bindings);
+    }
+
+    return ret;
+}
+
+void dedupDestroy(Ctx& ctx, Dedup& dedup) {
+    compDestroy(ctx, dedup.pipeline);
+    for (auto& buffer : dedup.hashes) {
+        buffertools::destroyBuffer(ctx, buffer);
+    }
+    buffertools::destroyBuffer(ctx, dedup.scoreCache);
+    buffertools::destroyBuffer(ctx, dedup.counter);
+    buffertools::destroyBuffer(ctx, dedup.counterReadback);
+}
+
+void dedupRecord(Ctx& ctx, Dedup& dedup) {
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dedup.pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, dedup.pipeline.pipelineLayout, 0, 1, &dedup.descriptorSets[ctx.frameCtx.frameIdx%2], 0, nullptr);
+    vkCmdDispatch(cmdBuffer, dedup.info.nrInstances, 1, 1);
+}
+
+void dedupAddScorePass(Ctx& ctx, RenderGraph& graph, Dedup& dedup) {
+    renderGraphAddPass(graph, GraphPass {
+        .name = "dedup_scores",
+        .uses = {
+            { .buffer = dedup.info.scoreBuffer->buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR },
+            { .buffer = dedup.scoreCache.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&dedup](Ctx& ctx) {
+            VkBufferCopy copyRegion{};
+            copyRegion.size = dedup.info.nrInstances * sizeof(float);
+            vkCmdCopyBuffer(ctx.frameCtx.cmdBuffer, dedup.info.scoreBuffer->buffer, dedup.scoreCache.buffer, 1, &copyRegion);
+        },
+    });
+}
+
+void dedupAddPass(Ctx& ctx, RenderGraph& graph, Dedup& dedup) {
+    const auto& info = dedup.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const uint32_t child = (frame+1)%2;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto read = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+    const auto write = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    renderGraphAddPass(graph, GraphPass {
+        .name = "dedup",
+        .uses = {
+            { .buffer = info.vertexBuffers[child]->buffer, .stage = stage, .access = read },
+            { .buffer = info.drawBuffers[child]->buffer, .stage = stage, .access = read | write },
+            { .buffer = info.parentBuffer->buffer, .stage = stage, .access = read },
+            { .buffer = dedup.hashes[frame].buffer, .stage = stage, .access = read },
+            { .buffer = dedup.hashes[child].buffer, .stage = stage, .access = write },
+            { .buffer = info.duplicates->buffer, .stage = stage, .access = write },
+            { .buffer = info.scoreBuffer->buffer, .stage = stage, .access = read | write },
+            { .buffer = dedup.scoreCache.buffer, .stage = stage, .access = read },
+            { .buffer = dedup.counter.buffer, .stage = stage, .access = read | write },
+        },
+        .record = [&dedup](Ctx& ctx) { dedupRecord(ctx, dedup); },
+    });
+    dedup.recorded++;
+
+    renderGraphAddPass(graph, GraphPass {
+        .name = "dedup_readback",
+        .uses = {
+            { .buffer = dedup.counter.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR },
+            { .buffer = dedup.counterReadback.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&dedup](Ctx& ctx) {
+            VkBufferCopy copyRegion{};
+            copyRegion.size = sizeof(uint32_t);
+            vkCmdCopyBuffer(ctx.frameCtx.cmdBuffer, dedup.counter.buffer, dedup.counterReadback.buffer, 1, &copyRegion);
+        },
+    });
+    // Records nothing, only makes the copy visible to the host after the frame fence
+    renderGraphAddPass(graph, GraphPass {
+        .name = "dedup_host_read",
+        .uses = {
+            { .buffer = dedup.counterReadback.buffer, .stage = VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+                .access = VK_ACCESS_2_HOST_READ_BIT_KHR },
+        },
+        .record = [](Ctx&) {},
+    });
+}
+
+float dedupRatio(Ctx& ctx, Dedup& dedup) {
+    uint32_t count;
+    void* data;
+    vkCheck(vmaMapMemory(ctx.allocator, dedup.counterReadback.memory, &data));
+    vmaInvalidateAllocation(ctx.allocator, dedup.counterReadback.memory, 0, sizeof(uint32_t));
+    memcpy(&count, data, sizeof(uint32_t));
+    vmaUnmapMemory(ctx.allocator, dedup.counterReadback.memory);
+
+    // unsigned differences stay right when the counter wraps
+    uint32_t found = count - dedup.lastCount;
+    uint32_t generations = dedup.recorded - dedup.lastRecorded;
+    dedup.lastCount = count;
+    dedup.lastRecorded = dedup.recorded;
+    if (generations == 0) {
+        return 0.0f;
+    }
+    return found / float(generations * dedup.info.nrInstances);
+}
@@ -2,23 +2,58 @@
 
 Evolve evolveCreate(Ctx& ctx, EvolveInfo& info) {
     Evolve ret{};
+    ret.info = info;
+    const bool variableLength = info.drawBuffers[0] != nullptr;
+    const bool adaptive = info.strategyBuffers[0] != nullptr;
+    const bool mesh = info.indexBuffers[0] != nullptr;
+    assert(!mesh || (!variableLength && !adaptive && info.meshVertices > 0));
 
     auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(EvolveArgs), 0);
     CompInfo compInfo {
-        .compShaderPath = "./shaders_bin/evolve.comp.spv",
+        .compShader = "evolve.comp",
         .bindingDescription = {
             { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
             { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
             { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
         },
         .pushConstantRange = &pushConstant,
+        .specializationConstants = { info.nrVertices, info.nrTrianglesPerInstance, variableLength, info.minTriangles, adaptive, info.meshVertices },
     };
     ret.pipeline = compCreate(ctx, compInfo);
 
+    // Fixed length genomes never touch the draws, the bindings only have to be valid
+    Buffer* draws[2] = { info.drawBuffers[0], info.drawBuffers[1] };
+    if (!variableLength) {
+        draws[0] = info.vertexBuffers[0];
+        draws[1] = info.vertexBuffers[1];
+    }
+    Buffer* strategies[2] = { info.strategyBuffers[0], info.strategyBuffers[1] };
+    if (!adaptive) {
+        strategies[0] = info.vertexBuffers[0];
+        strategies[1] = info.vertexBuffers[1];
+    }
+    Buffer* indices[2] = { info.indexBuffers[0], info.indexBuffers[1] };
+    if (!mesh) {
+        indices[0] = info.vertexBuffers[0];
+        indices[1] = info.vertexBuffers[1];
+    }
+
     CompResourceBindings bindings0 {
         { 0, info.vertexBuffers[0]->buffer },
         { 1, info.vertexBuffers[1]->buffer },
         { 2, info.parentBuffer->buffer },
+        { 3, draws[0]->buffer },
+        { 4, draws[1]->buffer },
+        { 5, strategies[0]->buffer },
+        { 6, strategies[1]->buffer },
+        { 7, indices[0]->buffer },
+        { 8, indices[1]->buffer },
     };
     ret.descriptorSets[0] = compCreateDescriptorSet(ctx, ret.pipeline, bindings0);
 
@@ -26,6 +61,12 @@ Evolve evolveCreate(Ctx& ctx, EvolveInfo& info) {
         { 0, info.vertexBuffers[1]->buffer },
         { 1, info.vertexBuffers[0]->buffer },
         { 2, info.parentBuffer->buffer },
+        { 3, draws[1]->buffer },
+        { 4, draws[0]->buffer },
+        { 5, strategies[1]->buffer },
+        { 6, strategies[0]->buffer },
+        { 7, indices[1]->buffer },
+        { 8, indices[0]->buffer },
     };
     ret.descriptorSets[1] = compCreateDescriptorSet(ctx, ret.pipeline, bindings1);
 
@@ -41,10 +82,39 @@ void evolveRecord(Ctx& ctx, Evolve& evolve, EvolveArgs& args) {
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, evolve.pipeline.pipeline);
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, evolve.pipeline.pipelineLayout, 0, 1, &evolve.descriptorSets[ctx.frameCtx.frameIdx%2], 0, nullptr);
     vkCmdPushConstants(cmdBuffer, evolve.pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(EvolveArgs), &args);
-    vkCmdDispatch(cmdBuffer, args.nrVertices/256+1, 1, 1);
-    auto barrier = vks::initializers::memoryBarrier();
-    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-            VK_DEPENDENCY_DEVICE_GROUP_BIT, 1, &barrier, 0, nullptr, 0, nullptr);
+    const auto& info = evolve.info;
+    uint32_t nrInvocations = info.nrVertices;
+    if (info.meshVertices > 0) {
+        // per instance one invocation for every vertex of the pool and every triangle
+        nrInvocations = info.nrVertices / info.meshVertices * std::max(info.meshVertices, info.nrTrianglesPerInstance);
+    }
+    vkCmdDispatch(cmdBuffer, nrInvocations/256+1, 1, 1);
+}
+
+void evolveAddPass(Ctx& ctx, RenderGraph& graph, Evolve& evolve, EvolveArgs args) {
+    const auto& info = evolve.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    GraphPass pass {
+        .name = "evolve",
+        .uses = {
+            { .buffer = info.vertexBuffers[frame]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR },
+            { .buffer = info.vertexBuffers[(frame+1)%2]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR },
+            { .buffer = info.parentBuffer->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR },
+        },
+        .record = [&evolve, args](Ctx& ctx) mutable { evolveRecord(ctx, evolve, args); },
+    };
+    if (info.drawBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.drawBuffers[frame]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR });
+        pass.uses.push_back({ .buffer = info.drawBuffers[(frame+1)%2]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR });
+    }
+    if (info.strategyBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.strategyBuffers[frame]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR });
+        pass.uses.push_back({ .buffer = info.strategyBuffers[(frame+1)%2]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR });
+    }
+    if (info.indexBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.indexBuffers[frame]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR });
+        pass.uses.push_back({ .buffer = info.indexBuffers[(frame+1)%2]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR });
+    }
+    renderGraphAddPass(graph, pass);
 }
@@ -24,3 +24,31 @@ float randf(float range) {
     return (f - 1.0) * range;                        // Range [0:1]
 }
 
+glm::uvec4 philox4x32(glm::uvec4 ctr, glm::uvec2 key) {
+    for (int round=0; round<10; round++) {
+        uint64_t p0 = uint64_t(0xD2511F53u) * ctr.x;
+        uint64_t p1 = uint64_t(0xCD9E8D57u) * ctr.z;
+        ctr = glm::uvec4(
+            uint32_t(p1 >> 32) ^ ctr.y ^ key.x, uint32_t(p1),
+            uint32_t(p0 >> 32) ^ ctr.w ^ key.y, uint32_t(p0));
+        key += glm::uvec2(0x9E3779B9u, 0xBB67AE85u);
+    }
+    return ctr;
+}
+
+CounterRng::CounterRng(uint32_t runSeed, uint32_t stream, uint32_t generation, uint32_t instance, uint32_t element)
+    : key(runSeed, stream), counter(generation, instance, element, 0) {}
+
+uint32_t CounterRng::randu() {
+    if (idx == 4) {
+        block = philox4x32(counter, key);
+        counter.w++;
+        idx = 0;
+    }
+    return block[idx++];
+}
+
+float CounterRng::randf(float range) {
+    // Same mapping as randf() in common.glsl
+    return randu() * 2.3283064365387e-10f * range;
+}
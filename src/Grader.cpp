@@ -1,4 +1,9 @@
 #include <Grader.h>
+#include <bit>
+
+size_t graderTilePartialsSize(const Image& gridImage) {
+    return (gridImage.width / 32) * (gridImage.height / 32) * gridImage.layers * sizeof(float);
+}
 
 Grader graderCreate(Ctx& ctx, GraderInfo& info) {
     Grader ret{};
@@ -6,49 +11,228 @@ Grader graderCreate(Ctx& ctx, GraderInfo& info) {
 
     assert(info.gridImage->width % 32 == 0);
     assert(info.gridImage->height % 32 == 0);
+    assert(info.instanceWidth % 32 == 0);
+    assert(!info.deterministic || info.instanceHeight % 32 == 0);
+    assert(!info.stochastic || info.instanceHeight % 32 == 0);
+    assert(info.nrInstancesPerGoal * info.goal->layers >= info.nrInstancesWidth * info.nrInstancesHeight * info.gridImage->layers);
 
     auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(GraderArgs), 0);
     CompInfo compInfo {
-        .compShaderPath = "./shaders_bin/grader.comp.spv",
+        // compact goals need the variant that reads them without a format
+        .compShader = info.goal->format == VK_FORMAT_R32G32B32A32_SFLOAT ? "grader.comp" : "grader_unformatted.comp",
         .bindingDescription = {
             { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
             { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
             { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
         },
         .pushConstantRange = &pushConstant,
+        .specializationConstants = {
+            info.nrInstancesWidth,
+            info.nrInstancesHeight,
+            info.instanceWidth,
+            info.instanceHeight,
+            info.nrInstancesPerGoal,
+            info.deterministic,
+            false,
+            info.gridImage->layers,
+            info.duplicates != nullptr,
+        },
     };
     ret.pipeline = compCreate(ctx, compInfo);
 
+    if (info.tilePartials) {
+        ret.tilePartials = *info.tilePartials;
+    } else {
+        ret.tilePartials = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, graderTilePartialsSize(*info.gridImage));
+    }
+
     CompResourceBindings bindings {
         { 0, info.gridImage->view },
         { 1, info.goal->view },
         { 2, info.scoreBuffer->buffer },
+        { 3, ret.tilePartials.buffer },
+        // only has to be valid without dedup
+        { 4, info.duplicates ? info.duplicates->buffer : info.scoreBuffer->buffer },
     };
     ret.descriptorSet = compCreateDescriptorSet(ctx, ret.pipeline, bindings);
+
+    if (info.deterministic) {
+        compInfo.specializationConstants[6] = true;
+        ret.resolvePipeline = compCreate(ctx, compInfo);
+        ret.resolveDescriptorSet = compCreateDescriptorSet(ctx, ret.resolvePipeline, bindings);
+    }
+    if (info.stochastic) {
+        uint32_t nrInstances = info.nrInstancesWidth * info.nrInstancesHeight * info.gridImage->layers;
+        assert(nrInstances % info.nrInstancesPerGoal == 0);
+        ReduceInfo reduceInfo {
+            .mode = REDUCE_MODE_REDUCE,
+            .op = REDUCE_OP_MAX,
+            .type = REDUCE_TYPE_FLOAT,
+            .input = info.scoreBuffer,
+            .segmentSize = info.nrInstancesPerGoal,
+            .nrSegments = nrInstances / info.nrInstancesPerGoal,
+        };
+        ret.bestScores = reduceCreate(ctx, reduceInfo);
+        ret.scoreReadback = buffertools::createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT, reduceInfo.nrSegments * sizeof(ReducePair));
+    }
     return ret;
 }
 
 void graderDestroy(Ctx& ctx, Grader& grader) {
     compDestroy(ctx, grader.pipeline);
+    if (grader.info.deterministic) {
+        compDestroy(ctx, grader.resolvePipeline);
+    }
+    if (!grader.info.tilePartials) {
+        buffertools::destroyBuffer(ctx, grader.tilePartials);
+    }
+    if (grader.info.stochastic) {
+        reduceDestroy(ctx, grader.bestScores);
+        buffertools::destroyBuffer(ctx, grader.scoreReadback);
+    }
 }
 
 void graderRecord(Ctx& ctx, Grader& grader, GraderArgs& args) {
-    assert(args.instanceWidth % 32 == 0);
-
+    const auto& info = grader.info;
+    // Workgroups and subgroups must not straddle two instances
+    assert(args.sampleStride == 1 || (info.instanceHeight / 32) % args.sampleStride == 0);
     auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, grader.pipeline.pipeline);
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, grader.pipeline.pipelineLayout, 0, 1, &grader.descriptorSet, 0, nullptr);
     vkCmdPushConstants(cmdBuffer, grader.pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GraderArgs), &args);
-    uint gridWidth = args.instanceWidth * args.nrInstancesWidth;
-    uint gridHeight = args.instanceHeight * args.nrInstancesHeight;
-    vkCmdDispatch(cmdBuffer, gridWidth/32, gridHeight/32, 1);
+    uint gridWidth = info.instanceWidth * info.nrInstancesWidth;
+    uint gridHeight = info.instanceHeight * info.nrInstancesHeight / args.sampleStride;
+    vkCmdDispatch(cmdBuffer, gridWidth/32, gridHeight/32, info.gridImage->layers);
+
+    if (info.deterministic) {
+        VkBufferMemoryBarrier2KHR barrier {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+            .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+            .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+            .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = grader.tilePartials.buffer,
+            .size = VK_WHOLE_SIZE,
+        };
+        VkDependencyInfoKHR dependencyInfo {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+            .bufferMemoryBarrierCount = 1,
+            .pBufferMemoryBarriers = &barrier,
+        };
+        ctx.cmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+
+        uint32_t nrInstances = info.nrInstancesWidth * info.nrInstancesHeight * info.gridImage->layers;
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, grader.resolvePipeline.pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, grader.resolvePipeline.pipelineLayout, 0, 1, &grader.resolveDescriptorSet, 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, grader.resolvePipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(GraderArgs), &args);
+        vkCmdDispatch(cmdBuffer, nrInstances/1024+1, 1, 1);
+    }
+}
+
+void graderAddPass(Ctx& ctx, RenderGraph& graph, Grader& grader, GraderArgs args) {
+    const auto& info = grader.info;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto readWrite = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+
+    GraphPass pass {
+        .name = "grader",
+        .uses = {
+            { .image = info.gridImage, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_GENERAL },
+            { .image = info.goal, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_GENERAL },
+            { .buffer = info.scoreBuffer->buffer, .stage = stage, .access = readWrite },
+        },
+        .record = [&grader, args](Ctx& ctx) mutable { graderRecord(ctx, grader, args); },
+    };
+    if (info.deterministic) {
+        // the barrier between the tile and resolve dispatches stays inside the pass
+        pass.uses.push_back({ .buffer = grader.tilePartials.buffer, .stage = stage, .access = readWrite });
+    }
+    if (info.duplicates) {
+        pass.uses.push_back({ .buffer = info.duplicates->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR });
+    }
+    renderGraphAddPass(graph, pass);
+
+    if (!info.stochastic) {
+        return;
+    }
+    // Only the best score of every goal goes back to the host
+    reduceAddPass(ctx, graph, grader.bestScores);
+    renderGraphAddPass(graph, GraphPass {
+        .name = "grader_readback",
+        .uses = {
+            { .buffer = grader.bestScores.output.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR },
+            { .buffer = grader.scoreReadback.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&grader](Ctx& ctx) {
+            VkBufferCopy copyRegion{};
+            copyRegion.size = grader.bestScores.info.nrSegments * sizeof(ReducePair);
+            vkCmdCopyBuffer(ctx.frameCtx.cmdBuffer, grader.bestScores.output.buffer, grader.scoreReadback.buffer, 1, &copyRegion);
+            grader.hasReadback = true;
+        },
+    });
+    // Records nothing, only makes the copy visible to the host after the frame fence
+    renderGraphAddPass(graph, GraphPass {
+        .name = "grader_host_read",
+        .uses = {
+            { .buffer = grader.scoreReadback.buffer, .stage = VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+                .access = VK_ACCESS_2_HOST_READ_BIT_KHR },
+        },
+        .record = [](Ctx&) {},
+    });
+}
 
-    auto barrier = vks::initializers::memoryBarrier();
-    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    auto imageBarrier = vks::initializers::imageMemoryBarrier(grader.info.gridImage->image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+void graderAddResetPass(Ctx& ctx, RenderGraph& graph, Grader& grader) {
+    renderGraphAddPass(graph, GraphPass {
+        .name = "grader_reset",
+        .uses = {
+            { .buffer = grader.info.scoreBuffer->buffer, .stage = VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&grader](Ctx& ctx) {
+            // 1.0f, the grader adds onto it
+            vkCmdFillBuffer(ctx.frameCtx.cmdBuffer, grader.info.scoreBuffer->buffer, 0, VK_WHOLE_SIZE, 0x3f800000);
+        },
+    });
+}
 
-    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-            VK_DEPENDENCY_DEVICE_GROUP_BIT, 1, &barrier, 0, nullptr, 1, &imageBarrier);
+float graderBestFitness(Ctx& ctx, Grader& grader) {
+    const auto& info = grader.info;
+    assert(info.stochastic);
+    if (!grader.hasReadback) {
+        return 0.0f;
+    }
+
+    const uint32_t nrGoals = grader.bestScores.info.nrSegments;
+    const size_t readbackSize = nrGoals * sizeof(ReducePair);
+    std::vector<ReducePair> best(nrGoals);
+    void* data;
+    vkCheck(vmaMapMemory(ctx.allocator, grader.scoreReadback.memory, &data));
+    vmaInvalidateAllocation(ctx.allocator, grader.scoreReadback.memory, 0, readbackSize);
+    memcpy(best.data(), data, readbackSize);
+    vmaUnmapMemory(ctx.allocator, grader.scoreReadback.memory);
+
+    // the slowest goal decides, the grid is graded with one stride
+    float lowest = std::numeric_limits<float>::max();
+    for (const auto& pair : best) {
+        lowest = std::min(lowest, std::bit_cast<float>(pair.value));
+    }
+    // the grader accumulates on top of a base score of 1
+    return (lowest - 1.0f) / (info.instanceWidth * info.instanceHeight);
+}
 
+uint32_t graderScheduleStride(const GraderInfo& info, float fitness) {
+    float progress = std::clamp(fitness / info.fullSampleFitness, 0.0f, 1.0f);
+    uint32_t wanted = std::max(1u, static_cast<uint32_t>(info.maxSampleStride * (1.0f - progress) + 0.5f));
+    for (uint32_t stride=wanted; stride>1; stride--) {
+        if ((info.instanceHeight / 32) % stride == 0) {
+            return stride;
+        }
+    }
+    return 1;
 }
@@ -1,53 +1,172 @@
 #include <GridRender.h>
 
+void _initInstanced(Ctx& ctx, GridRender& gridRender);
+
 GridRender gridRenderCreate(Ctx& ctx, GridRenderInfo& info) {
     GridRender gridRender{ .info = info };
+    assert(info.nrTriangles % (info.nrInstancesWidth * info.nrInstancesHeight * info.target.layers) == 0);
+    assert(info.instanced || !info.drawBuffers[0]);
+    assert(!info.indexBuffers[0] || (info.instanced && !info.drawBuffers[0] && info.meshVertices > 0));
 
-
+    // Layout transitions of the target are left to the render graph
     RenderPassInfo renderPassInfo{
-        .finalLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .images = {info.target},
+        .beforeLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
     };
+    for (uint32_t layer=0; layer<info.target.layers; layer++) {
+        Image layerImage = info.target;
+        layerImage.view = createImageLayerView(ctx, info.target, layer);
+        layerImage.layers = 1;
+        gridRender.layerViews.push_back(layerImage.view);
+        renderPassInfo.images.push_back(layerImage);
+    }
     gridRender.renderPass = renderPassCreate(ctx, renderPassInfo);
 
-    auto vertexDescription = Vertex::getVertexDescription();
     RastPipelineInfo rastInfo {
-        .vsPath = "./shaders_bin/grid.vert.spv",
-        .fsPath = "./shaders_bin/grid.frag.spv",
+        .vertShader = "grid.vert",
+        .fragShader = "grid.frag",
         .renderPass = &gridRender.renderPass,
-        .vertexDescription = &vertexDescription,
-        .pushConstantRanges = {
-            vks::initializers::pushConstantRange(VK_SHADER_STAGE_VERTEX_BIT, sizeof(GridRenderArgs), 0),
-        },
+        .specializationConstants = { info.nrTriangles, info.nrInstancesWidth, info.nrInstancesHeight, info.target.layers, info.meshVertices },
+        .viewport = { info.target.width, info.target.height },
     };
+
+    auto vertexDescription = Vertex::getVertexDescription();
+    if (info.instanced) {
+        _initInstanced(ctx, gridRender);
+        vertexDescription = InstanceCell::getVertexDescription();
+        rastInfo.vertShader = "grid_instanced.vert";
+        rastInfo.descriptorSetLayouts = { gridRender.descriptorLayout };
+    }
+    rastInfo.vertexDescription = &vertexDescription;
     gridRender.pipeline = rastPipelineCreate(ctx, rastInfo);
 
 
     return gridRender;
 }
 
+void _initInstanced(Ctx& ctx, GridRender& gridRender) {
+    const auto& info = gridRender.info;
+    const uint32_t instancesPerLayer = info.nrInstancesWidth * info.nrInstancesHeight;
+
+    std::vector<InstanceCell> cells(instancesPerLayer * info.target.layers);
+    for (uint32_t i=0; i<cells.size(); i++) {
+        uint32_t cell = i % instancesPerLayer;
+        glm::vec2 size(1.0f / info.nrInstancesWidth, 1.0f / info.nrInstancesHeight);
+        glm::vec2 offset = glm::vec2(cell % info.nrInstancesWidth, cell / info.nrInstancesWidth) * size;
+        cells[i].rect = glm::vec4(offset, offset + size);
+    }
+    gridRender.instanceCells = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            cells.size() * sizeof(InstanceCell), cells.data());
+    if (info.indexBuffers[0]) {
+        // The index ranges never move, only the indices in them evolve
+        const uint32_t nrInstances = instancesPerLayer * info.target.layers;
+        auto draws = meshDraws(nrInstances, info.nrTriangles / nrInstances);
+        gridRender.meshDraws = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                draws.size() * sizeof(VkDrawIndexedIndirectCommand), draws.data());
+    }
+
+    auto binding = vks::initializers::descriptorSetLayoutBinding(
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
+    auto layoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(&binding, 1);
+    vkCheck(vkCreateDescriptorSetLayout(ctx.device, &layoutInfo, nullptr, &gridRender.descriptorLayout));
+
+    for (uint32_t i=0; i<2; i++) {
+        gridRender.descriptorSets[i] = ctxAllocDescriptorSet(ctx, gridRender.descriptorLayout);
+        auto bufferInfo = vks::initializers::descriptorBufferInfo(info.buffers[i]->buffer);
+        auto write = vks::initializers::writeDescriptorSet(gridRender.descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 0, &bufferInfo);
+        vkUpdateDescriptorSets(ctx.device, 1, &write, 0, nullptr);
+    }
+}
+
 void gridRenderDestroy(Ctx& ctx, GridRender& gridRender) {
     rastPipelineDestroy(ctx, gridRender.pipeline);
     renderPassDestroy(ctx, gridRender.renderPass);
+    for (auto view : gridRender.layerViews) {
+        vkDestroyImageView(ctx.device, view, nullptr);
+    }
+    if (gridRender.info.instanced) {
+        vkDestroyDescriptorSetLayout(ctx.device, gridRender.descriptorLayout, nullptr);
+        buffertools::destroyBuffer(ctx, gridRender.instanceCells);
+    }
+    if (gridRender.info.indexBuffers[0]) {
+        buffertools::destroyBuffer(ctx, gridRender.meshDraws);
+    }
 }
 
-void grindRenderRecord(Ctx& ctx, GridRender& gridRender, GridRenderArgs& push) {
+void grindRenderRecord(Ctx& ctx, GridRender& gridRender) {
     VkCommandBuffer cmdBuffer = ctx.frameCtx.cmdBuffer;
 
+    const auto& info = gridRender.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    // gl_VertexIndex includes firstVertex and gl_InstanceIndex firstInstance,
+    // so each pass draws the instances of its layer
+    const uint32_t verticesPerLayer = 3 * info.nrTriangles / info.target.layers;
+    const uint32_t instancesPerLayer = info.nrInstancesWidth * info.nrInstancesHeight;
+    const uint32_t verticesPerInstance = verticesPerLayer / instancesPerLayer;
+
     VkClearValue clearColor { .color = {0.0f, 0.0f, 0.0f, 0.0f}, };
-    auto renderPassInfo = vks::initializers::renderPassBeginInfo(
-            gridRender.renderPass.renderPass,
-            gridRender.renderPass.framebuffers[0]);
-    renderPassInfo.renderArea.extent = {gridRender.info.target.width, gridRender.info.target.height};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-
-    vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    VkDeviceSize offset = 0;
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridRender.pipeline.pipeline);
-    vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &gridRender.info.buffers[ctx.frameCtx.frameIdx%2]->buffer, &offset);
-    vkCmdPushConstants(cmdBuffer, gridRender.pipeline.pipelineLayout,
-            VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GridRenderArgs), &push);
-    vkCmdDraw(cmdBuffer, 3 * push.nrTriangles, 1, 0, 0);
-    vkCmdEndRenderPass(cmdBuffer);
+    for (uint32_t layer=0; layer<info.target.layers; layer++) {
+        auto renderPassInfo = vks::initializers::renderPassBeginInfo(
+                gridRender.renderPass.renderPass,
+                gridRender.renderPass.framebuffers[layer]);
+        renderPassInfo.renderArea.extent = {info.target.width, info.target.height};
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearColor;
+
+        vkCmdBeginRenderPass(cmdBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        VkDeviceSize offset = 0;
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridRender.pipeline.pipeline);
+        if (info.instanced) {
+            vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, gridRender.pipeline.pipelineLayout,
+                    0, 1, &gridRender.descriptorSets[frame], 0, nullptr);
+            vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &gridRender.instanceCells.buffer, &offset);
+            if (info.indexBuffers[0]) {
+                // one indexed draw per instance, gl_VertexIndex is the index within its pool
+                vkCmdBindIndexBuffer(cmdBuffer, info.indexBuffers[frame]->buffer, 0, VK_INDEX_TYPE_UINT32);
+                vkCmdDrawIndexedIndirect(cmdBuffer, gridRender.meshDraws.buffer,
+                        layer * instancesPerLayer * sizeof(VkDrawIndexedIndirectCommand), instancesPerLayer, sizeof(VkDrawIndexedIndirectCommand));
+            } else if (info.drawBuffers[0]) {
+                // one draw per instance, its firstInstance picks the genome and the cell
+                vkCmdDrawIndirect(cmdBuffer, info.drawBuffers[frame]->buffer,
+                        layer * instancesPerLayer * sizeof(VkDrawIndirectCommand), instancesPerLayer, sizeof(VkDrawIndirectCommand));
+            } else {
+                vkCmdDraw(cmdBuffer, verticesPerInstance, instancesPerLayer, 0, layer * instancesPerLayer);
+            }
+        } else {
+            vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &info.buffers[frame]->buffer, &offset);
+            vkCmdDraw(cmdBuffer, verticesPerLayer, 1, layer * verticesPerLayer, 0);
+        }
+        vkCmdEndRenderPass(cmdBuffer);
+    }
+}
+
+void gridRenderAddPass(Ctx& ctx, RenderGraph& graph, GridRender& gridRender) {
+    const auto& info = gridRender.info;
+    GraphUse genome { .buffer = info.buffers[ctx.frameCtx.frameIdx%2]->buffer };
+    if (info.instanced) {
+        genome.stage = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT_KHR;
+        genome.access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+    } else {
+        genome.stage = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT_KHR;
+        genome.access = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT_KHR;
+    }
+
+    GraphPass pass {
+        .name = "grid_render",
+        .uses = {
+            genome,
+            { .image = &gridRender.info.target, .stage = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+                .access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, .discard = true },
+        },
+        .record = [&gridRender](Ctx& ctx) { grindRenderRecord(ctx, gridRender); },
+    };
+    if (info.drawBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.drawBuffers[ctx.frameCtx.frameIdx%2]->buffer,
+                .stage = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, .access = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR });
+    }
+    if (info.indexBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.indexBuffers[ctx.frameCtx.frameIdx%2]->buffer,
+                .stage = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT_KHR, .access = VK_ACCESS_2_INDEX_READ_BIT_KHR });
+    }
+    renderGraphAddPass(graph, pass);
 }
@@ -6,23 +6,14 @@ Image createImageD(Ctx& ctx, uint32_t width, uint32_t height, VkImageUsageFlags
     ret.height = height;
     ret.format = format;
     auto imageCreateInfo = vks::initializers::imageCreateInfo(width, height, format, usage);
+    ctxShareWithTransferQueue(ctx, imageCreateInfo);
     VmaAllocationCreateInfo allocInfo { .usage = VMA_MEMORY_USAGE_GPU_ONLY };
     vkCheck(vmaCreateImage(ctx.allocator, &imageCreateInfo, &allocInfo, &ret.image, &ret.memory, nullptr));
 
     auto viewInfo = vks::initializers::imageViewCreateInfo(ret.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
     vkCheck(vkCreateImageView(ctx.device, &viewInfo, nullptr, &ret.view));
 
-    ctxSingleTimeCommand(ctx, [&](VkCommandBuffer cmdBuffer) {
-        auto barrier = vks::initializers::imageMemoryBarrier(ret.image, VK_IMAGE_LAYOUT_UNDEFINED, initialLayout);
-        vkCmdPipelineBarrier(
-            cmdBuffer,
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_DEPENDENCY_BY_REGION_BIT,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-        });
+    uploaderTransition(ctx, ctx.uploader, ret, initialLayout);
     return ret;
 }
 
@@ -36,37 +27,86 @@ Image loadImageD(Ctx& ctx, VkImageLayout initialLayout, const char* filename) {
 
     assert(nrChannels == 4 && "Image loading should produce a 4 channel buffer");
 
-    VkDeviceSize imageSize = width * height * 4 * sizeof(float);
-    Buffer stagingBuffer = buffertools::createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, imageSize);
+    Image dst = createImageD(ctx, width, height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_R32G32B32A32_SFLOAT, initialLayout);
+    uploadImageLayerD(ctx, dst, 0, initialLayout, pixels);
+    stbi_image_free(pixels);
 
-    void* data;
-    vkCheck(vmaMapMemory(ctx.allocator, stagingBuffer.memory, &data));
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vmaUnmapMemory(ctx.allocator, stagingBuffer.memory);
-    vmaFlushAllocation(ctx.allocator, stagingBuffer.memory, 0, imageSize);
+    return dst;
+}
+
+Image createImageArrayD(Ctx& ctx, uint32_t width, uint32_t height, uint32_t layers, VkImageUsageFlags usage, VkFormat format, VkImageLayout initialLayout) {
+    Image ret{};
+    ret.width = width;
+    ret.height = height;
+    ret.layers = layers;
+    ret.format = format;
+    auto imageCreateInfo = vks::initializers::imageCreateInfo(width, height, format, usage);
+    imageCreateInfo.arrayLayers = layers;
+    ctxShareWithTransferQueue(ctx, imageCreateInfo);
+    VmaAllocationCreateInfo allocInfo { .usage = VMA_MEMORY_USAGE_GPU_ONLY };
+    vkCheck(vmaCreateImage(ctx.allocator, &imageCreateInfo, &allocInfo, &ret.image, &ret.memory, nullptr));
 
-    Image dst = createImageD(ctx, width, height, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    auto viewInfo = vks::initializers::imageViewCreateInfo(ret.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    viewInfo.subresourceRange.layerCount = layers;
+    vkCheck(vkCreateImageView(ctx.device, &viewInfo, nullptr, &ret.view));
 
-    ctxSingleTimeCommand(ctx, [&](VkCommandBuffer cmdBuffer) {
-        VkBufferImageCopy copyRegion = vks::initializers::imageCopy(width, height);
-        vkCmdCopyBufferToImage(cmdBuffer, stagingBuffer.buffer, dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-        auto barrier = vks::initializers::imageMemoryBarrier(dst.image, VK_IMAGE_LAYOUT_UNDEFINED, initialLayout);
-    vkCmdPipelineBarrier(
-            cmdBuffer,
-            VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-            VK_DEPENDENCY_BY_REGION_BIT,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier);
-    });
+    uploaderTransition(ctx, ctx.uploader, ret, initialLayout);
+    return ret;
+}
 
+Image loadImageArrayD(Ctx& ctx, VkImageLayout layout, const std::vector<const char*>& filenames) {
+    assert(filenames.size() > 0);
+    int width, height, nrChannels;
+    if (!stbi_info(filenames[0], &width, &height, &nrChannels)) {
+        logger::error("Could not load image {}", filenames[0]);
+        exit(1);
+    }
 
-    buffertools::destroyBuffer(ctx, stagingBuffer);
+    Image dst = createImageArrayD(ctx, width, height, filenames.size(),
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_FORMAT_R32G32B32A32_SFLOAT, layout);
 
+    for (uint32_t layer=0; layer<filenames.size(); layer++) {
+        uploadImageLayerD(ctx, dst, layer, layout, filenames[layer]);
+    }
     return dst;
 }
 
+void uploadImageLayerD(Ctx& ctx, Image& image, uint32_t layer, VkImageLayout layout, const char* filename) {
+    int width, height, nrChannels;
+    float* pixels = stbi_loadf(filename, &width, &height, &nrChannels, STBI_rgb_alpha);
+    if (!pixels) {
+        logger::error("Could not load image {}", filename);
+        exit(1);
+    }
+
+    if (width != image.width || height != image.height) {
+        logger::error("Image {} is {}x{}, expected {}x{}", filename, width, height, image.width, image.height);
+        exit(1);
+    }
+
+    uploadImageLayerD(ctx, image, layer, layout, pixels);
+    stbi_image_free(pixels);
+}
+
+void uploadImageLayerD(Ctx& ctx, Image& image, uint32_t layer, VkImageLayout layout, const float* pixels) {
+    assert(layer < image.layers);
+    assert(image.format == VK_FORMAT_R32G32B32A32_SFLOAT && "Only float goal images can be uploaded");
+
+    size_t imageSize = image.width * image.height * 4 * sizeof(float);
+    uploaderImageLayer(ctx, ctx.uploader, image, layer, layout, pixels, imageSize);
+}
+
+VkImageView createImageLayerView(Ctx& ctx, const Image& image, uint32_t layer) {
+    assert(layer < image.layers);
+    auto viewInfo = vks::initializers::imageViewCreateInfo(image.image, image.format, VK_IMAGE_ASPECT_COLOR_BIT);
+    viewInfo.subresourceRange.baseArrayLayer = layer;
+    VkImageView ret;
+    vkCheck(vkCreateImageView(ctx.device, &viewInfo, nullptr, &ret));
+    return ret;
+}
+
 void destroyImage(Ctx& ctx, Image& image) {
     vkDestroyImageView(ctx.device, image.view, nullptr);
     vmaDestroyImage(ctx.allocator, image.image, image.memory);
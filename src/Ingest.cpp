@@ -0,0 +1,236 @@
+#include <Ingest.h>
+#include <cmath>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+void _work(IngestInfo info, IngestQueue* queue, uint8_t* mapped, size_t layerSize);
+std::string _decode(const IngestInfo& info, const std::string& path, uint8_t* dst);
+void _convertLdr(const IngestInfo& info, const stbi_uc* pixels, uint8_t* dst);
+void _convertHdr(const IngestInfo& info, const float* pixels, uint8_t* dst);
+
+Ingest ingestCreate(Ctx& ctx, IngestInfo& info) {
+    assert(std::find(ingestFormats.begin(), ingestFormats.end(), info.format) != ingestFormats.end());
+    assert(info.nrSlots > 0);
+    Ingest ret{ .info = info };
+    ret.layerSize = size_t(info.width) * info.height * ingestTexelSize(info.format);
+
+    auto bufferInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            static_cast<VkDeviceSize>(ret.layerSize * info.nrSlots));
+    VmaAllocationCreateInfo allocInfo {
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY,
+    };
+    VmaAllocationInfo allocationInfo;
+    vkCheck(vmaCreateBuffer(ctx.allocator, &bufferInfo, &allocInfo, &ret.staging.buffer, &ret.staging.memory, &allocationInfo));
+    ret.mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+
+    ret.queue = std::make_unique<IngestQueue>();
+    auto& q = *ret.queue;
+    q.running = true;
+    q.results.resize(info.nrSlots);
+    uint32_t nrThreads = info.nrThreads > 0 ? info.nrThreads : std::max(1u, std::thread::hardware_concurrency());
+    nrThreads = std::min<uint32_t>(nrThreads, info.nrSlots);
+    // The queue lives on the heap, so the Ingest itself may still be moved
+    for (uint32_t i=0; i<nrThreads; i++) {
+        q.threads.emplace_back(_work, info, ret.queue.get(), ret.mapped, ret.layerSize);
+    }
+
+    logger::info("Ingesting {} goal images on {} threads, {} ahead", info.paths.size(), nrThreads, info.nrSlots);
+    return ret;
+}
+
+void ingestDestroy(Ctx& ctx, Ingest& ingest) {
+    auto& q = *ingest.queue;
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.running = false;
+    }
+    q.slotFreed.notify_all();
+    for (auto& thread : q.threads) {
+        thread.join();
+    }
+    vmaDestroyBuffer(ctx.allocator, ingest.staging.buffer, ingest.staging.memory);
+}
+
+void ingestUpload(Ctx& ctx, Ingest& ingest, Image& image, uint32_t layer, VkImageLayout layout) {
+    assert(image.format == ingest.info.format);
+    const uint32_t job = ingest.nextUpload++;
+    assert(job < ingest.info.paths.size());
+    const uint32_t slot = job % ingest.info.nrSlots;
+
+    // More uploads in one frame than there are slots, the oldest copy has to finish first
+    ingestRetire(ctx, ingest);
+    while (!ingest.uploading.empty() && ingest.uploading.front().first + ingest.info.nrSlots <= job) {
+        uploaderFlush(ctx, ctx.uploader);
+        uploaderWait(ctx, ctx.uploader, ingest.uploading.front().second);
+        ingestRetire(ctx, ingest);
+    }
+
+    std::string result;
+    {
+        auto& q = *ingest.queue;
+        std::unique_lock<std::mutex> lock(q.mutex);
+        if (q.results[slot].empty()) {
+            logger::debug("Waiting for {} to be decoded", ingest.info.paths[job]);
+        }
+        q.decoded.wait(lock, [&] { return !q.results[slot].empty(); });
+        result = std::exchange(q.results[slot], {});
+    }
+    if (result != "ok") {
+        logger::error(result);
+        exit(1);
+    }
+
+    const size_t offset = slot * ingest.layerSize;
+    vmaFlushAllocation(ctx.allocator, ingest.staging.memory, offset, ingest.layerSize);
+    uint64_t value = uploaderCopyImageLayer(ctx, ctx.uploader, ingest.staging, offset, image, layer, layout);
+    ingest.uploading.emplace_back(job, value);
+}
+
+void ingestRetire(Ctx& ctx, Ingest& ingest) {
+    std::optional<uint32_t> released;
+    while (!ingest.uploading.empty() && uploaderDone(ctx, ctx.uploader, ingest.uploading.front().second)) {
+        released = ingest.uploading.front().first + 1;
+        ingest.uploading.pop_front();
+    }
+    if (!released) {
+        return;
+    }
+
+    auto& q = *ingest.queue;
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.released = *released;
+    }
+    q.slotFreed.notify_all();
+}
+
+size_t ingestTexelSize(VkFormat format) {
+    switch (format) {
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 4 * sizeof(float);
+    case VK_FORMAT_R16G16B16A16_UNORM:
+        return 4 * sizeof(uint16_t);
+    case VK_FORMAT_R8G8B8A8_UNORM:
+        return 4 * sizeof(uint8_t);
+    default:
+        logger::crash(fmt::format("Goal images cannot be ingested as format {}", static_cast<int>(format)));
+        return 0;
+    }
+}
+
+// Private implementation
+
+void _work(IngestInfo info, IngestQueue* queue, uint8_t* mapped, size_t layerSize) {
+    while (true) {
+        uint32_t job;
+        {
+            std::unique_lock<std::mutex> lock(queue->mutex);
+            // A job may only take its slot once the one nrSlots before it has left it
+            queue->slotFreed.wait(lock, [&] {
+                return !queue->running || (queue->nextDecode < info.paths.size() && queue->nextDecode < queue->released + info.nrSlots);
+            });
+            if (!queue->running) {
+                return;
+            }
+            job = queue->nextDecode++;
+        }
+
+        const uint32_t slot = job % info.nrSlots;
+        std::string result = _decode(info, info.paths[job], mapped + slot * layerSize);
+        {
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            queue->results[slot] = result;
+        }
+        queue->decoded.notify_all();
+    }
+}
+
+std::string _decode(const IngestInfo& info, const std::string& path, uint8_t* dst) {
+    // Mapped so stb decodes straight from the page cache, without a copy through a FILE
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return fmt::format("Could not load image {}", path);
+    }
+    struct stat fileStat;
+    void* file = MAP_FAILED;
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        file = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (file == MAP_FAILED) {
+        return fmt::format("Could not map image {}", path);
+    }
+    madvise(file, fileStat.st_size, MADV_SEQUENTIAL);
+
+    const auto* bytes = static_cast<const stbi_uc*>(file);
+    const int length = static_cast<int>(fileStat.st_size);
+    int width, height, nrChannels;
+    std::string ret = "ok";
+    if (stbi_is_hdr_from_memory(bytes, length)) {
+        float* pixels = stbi_loadf_from_memory(bytes, length, &width, &height, &nrChannels, STBI_rgb_alpha);
+        if (!pixels) {
+            ret = fmt::format("Could not load image {}", path);
+        } else if (width != info.width || height != info.height) {
+            ret = fmt::format("Image {} is {}x{}, expected {}x{}", path, width, height, info.width, info.height);
+        } else {
+            _convertHdr(info, pixels, dst);
+        }
+        stbi_image_free(pixels);
+    } else {
+        // 8 bits per channel like stbi_loadf, which converts them the same way afterwards
+        stbi_uc* pixels = stbi_load_from_memory(bytes, length, &width, &height, &nrChannels, STBI_rgb_alpha);
+        if (!pixels) {
+            ret = fmt::format("Could not load image {}", path);
+        } else if (width != info.width || height != info.height) {
+            ret = fmt::format("Image {} is {}x{}, expected {}x{}", path, width, height, info.width, info.height);
+        } else {
+            _convertLdr(info, pixels, dst);
+        }
+        stbi_image_free(pixels);
+    }
+    munmap(file, fileStat.st_size);
+    return ret;
+}
+
+void _convertLdr(const IngestInfo& info, const stbi_uc* pixels, uint8_t* dst) {
+    // Colors get the default gamma of 2.2 of stbi_loadf, alpha stays linear
+    static const auto linear = [] {
+        std::array<float, 256> ret;
+        for (uint32_t i=0; i<256; i++) {
+            ret[i] = std::pow(i / 255.0f, 2.2f);
+        }
+        return ret;
+    }();
+
+    const size_t nrValues = 4 * size_t(info.width) * info.height;
+    for (size_t i=0; i<nrValues; i++) {
+        const bool alpha = i % 4 == 3;
+        const float value = alpha ? pixels[i] / 255.0f : linear[pixels[i]];
+        if (info.format == VK_FORMAT_R32G32B32A32_SFLOAT) {
+            reinterpret_cast<float*>(dst)[i] = value;
+        } else if (info.format == VK_FORMAT_R16G16B16A16_UNORM) {
+            reinterpret_cast<uint16_t*>(dst)[i] = alpha ? pixels[i] * 257 : static_cast<uint16_t>(std::lround(value * 65535.0f));
+        } else {
+            dst[i] = alpha ? pixels[i] : static_cast<uint8_t>(std::lround(value * 255.0f));
+        }
+    }
+}
+
+void _convertHdr(const IngestInfo& info, const float* pixels, uint8_t* dst) {
+    const size_t nrValues = 4 * size_t(info.width) * info.height;
+    if (info.format == VK_FORMAT_R32G32B32A32_SFLOAT) {
+        memcpy(dst, pixels, nrValues * sizeof(float));
+        return;
+    }
+    for (size_t i=0; i<nrValues; i++) {
+        const float value = std::clamp(pixels[i], 0.0f, 1.0f);
+        if (info.format == VK_FORMAT_R16G16B16A16_UNORM) {
+            reinterpret_cast<uint16_t*>(dst)[i] = static_cast<uint16_t>(std::lround(value * 65535.0f));
+        } else {
+            dst[i] = static_cast<uint8_t>(std::lround(value * 255.0f));
+        }
+    }
+}
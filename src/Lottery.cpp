@@ -1,16 +1,20 @@
 #include <Lottery.h>
 
 Lottery lotteryCreate(Ctx& ctx, LotteryInfo& info) {
+    assert(info.nrInstancesPerGroup <= 1024 && "Instances of a group must be handled in the same workgroup");
+    assert(info.nrInstances % info.nrInstancesPerGroup == 0);
     Lottery ret{};
+    ret.info = info;
 
     auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(LotteryArgs), 0);
     CompInfo compInfo {
-        .compShaderPath = "./shaders_bin/lottery.comp.spv",
+        .compShader = "lottery.comp",
         .bindingDescription = {
             { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
             { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
         },
         .pushConstantRange = &pushConstant,
+        .specializationConstants = { info.nrInstances, info.nrInstancesPerGroup },
     };
     ret.pipeline = compCreate(ctx, compInfo);
 
@@ -28,15 +32,22 @@ void lotteryDestroy(Ctx& ctx, Lottery& lottery) {
 }
 
 void lotteryRecord(Ctx& ctx, Lottery& lottery, LotteryArgs& args) {
-    assert(args.nrInstances <= 1024 && "Instances must be handled in the same workgroup");
     auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
     vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lottery.pipeline.pipeline);
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lottery.pipeline.pipelineLayout, 0, 1, &lottery.descriptorSet, 0, nullptr);
     vkCmdPushConstants(cmdBuffer, lottery.pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(LotteryArgs), &args);
-    vkCmdDispatch(cmdBuffer, 1, 1, 1);
-    auto barrier = vks::initializers::memoryBarrier();
-    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-            VK_DEPENDENCY_DEVICE_GROUP_BIT, 1, &barrier, 0, nullptr, 0, nullptr);
+    vkCmdDispatch(cmdBuffer, lottery.info.nrInstances / lottery.info.nrInstancesPerGroup, 1, 1);
+}
+
+void lotteryAddPass(Ctx& ctx, RenderGraph& graph, Lottery& lottery, LotteryArgs args) {
+    renderGraphAddPass(graph, GraphPass {
+        .name = "lottery",
+        .uses = {
+            { .buffer = lottery.info.scoreBuffer->buffer, .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR },
+            { .buffer = lottery.info.parentBuffer->buffer, .stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+                .access = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR },
+        },
+        .record = [&lottery, args](Ctx& ctx) mutable { lotteryRecord(ctx, lottery, args); },
+    });
 }
@@ -0,0 +1,172 @@
+#include <Metrics.h>
+#include <sstream>
+#include <poll.h>
+#include <unistd.h>
+
+// Weight of the newest generation in the smoothed rate
+constexpr double metricsRateSmoothing = 0.01;
+
+void _serve(MetricsCounters* counters);
+std::string _render(const MetricsCounters& counters);
+
+Metrics metricsCreate(MetricsInfo& info) {
+    Metrics ret{ .info = info };
+    ret.counters = std::make_unique<MetricsCounters>();
+    auto& c = *ret.counters;
+    c.listenSocket = socketListen(info.endpoint);
+    c.running = true;
+    // The counters live on the heap, so the Metrics itself may still be moved
+    c.thread = std::thread(_serve, ret.counters.get());
+
+    if (info.endpoint.path) {
+        logger::info("Metrics on unix socket {}", info.endpoint.path);
+    } else {
+        logger::info("Metrics on http://localhost:{}/metrics", info.endpoint.port);
+    }
+    return ret;
+}
+
+void metricsDestroy(Metrics& metrics) {
+    auto& c = *metrics.counters;
+    c.running = false;
+    c.thread.join();
+    socketClose(c.listenSocket, metrics.info.endpoint);
+}
+
+void metricsFrame(Metrics& metrics, double frameWaitSeconds, double submitSeconds) {
+    auto& c = *metrics.counters;
+    const double now = glfwGetTime();
+    const uint64_t generations = c.generations.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (generations > 1) {
+        const double rate = 1.0 / std::max(now - metrics.lastFrame, 1e-9);
+        const double smoothed = c.generationsPerSecond.load(std::memory_order_relaxed);
+        c.generationsPerSecond.store(generations == 2 ? rate : smoothed + metricsRateSmoothing * (rate - smoothed),
+                std::memory_order_relaxed);
+    }
+    metrics.lastFrame = now;
+    c.frameWaitSeconds.store(frameWaitSeconds, std::memory_order_relaxed);
+    c.submitSeconds.store(submitSeconds, std::memory_order_relaxed);
+}
+
+void metricsStages(Metrics& metrics, const std::vector<ProfilerScope>& scopes) {
+    auto& stages = metrics.counters->stages;
+    // Passes that share a name, like the levels of a reduce, add up to one stage
+    std::array<double, metricsMaxStages> seconds{};
+    std::array<bool, metricsMaxStages> seen{};
+    for (const auto& scope : scopes) {
+        for (uint32_t s=0; s<stages.size(); s++) {
+            const char* name = stages[s].name.load(std::memory_order_relaxed);
+            if (name == nullptr || strcmp(name, scope.name) == 0) {
+                seconds[s] += scope.seconds;
+                // Only this thread adds stages, the server reads a slot once its name is set
+                if (name == nullptr) {
+                    stages[s].seconds.store(seconds[s], std::memory_order_relaxed);
+                    stages[s].name.store(scope.name, std::memory_order_release);
+                }
+                seen[s] = true;
+                break;
+            }
+        }
+    }
+    for (uint32_t s=0; s<stages.size(); s++) {
+        if (seen[s]) {
+            stages[s].seconds.store(seconds[s], std::memory_order_relaxed);
+        }
+    }
+}
+
+void metricsFitness(Metrics& metrics, uint32_t goal, float bestFitness, float meanFitness) {
+    auto& c = *metrics.counters;
+    if (goal >= metricsMaxGoals) {
+        return;
+    }
+    c.goals[goal].bestFitness.store(bestFitness, std::memory_order_relaxed);
+    c.goals[goal].meanFitness.store(meanFitness, std::memory_order_relaxed);
+    if (goal >= c.nrGoals.load(std::memory_order_relaxed)) {
+        c.nrGoals.store(goal + 1, std::memory_order_release);
+    }
+}
+
+void metricsMemory(Metrics& metrics, const Ctx& ctx) {
+    auto& c = *metrics.counters;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(ctx.physicalDevice, &memoryProperties);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetBudget(ctx.allocator, budgets);
+    for (uint32_t heap=0; heap<memoryProperties.memoryHeapCount; heap++) {
+        c.heaps[heap].usage.store(budgets[heap].usage, std::memory_order_relaxed);
+        c.heaps[heap].budget.store(budgets[heap].budget, std::memory_order_relaxed);
+    }
+    c.nrHeaps.store(memoryProperties.memoryHeapCount, std::memory_order_release);
+}
+
+// Private implementation
+
+void _serve(MetricsCounters* counters) {
+    while (counters->running.load()) {
+        // Wakes up now and then to see whether it should stop
+        int client = socketAccept(counters->listenSocket, 100);
+        if (client < 0) {
+            continue;
+        }
+
+        // Every request gets the metrics, whatever its path
+        char request[1024];
+        pollfd readable { .fd = client, .events = POLLIN };
+        if (poll(&readable, 1, 100) > 0) {
+            [[maybe_unused]] auto ignored = read(client, request, sizeof(request));
+        }
+        auto body = _render(*counters);
+        auto response = fmt::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\n\r\n{}",
+                body.size(), body);
+        socketSend(client, response);
+        close(client);
+    }
+}
+
+std::string _render(const MetricsCounters& c) {
+    const auto relaxed = std::memory_order_relaxed;
+    std::ostringstream out;
+    out << "# TYPE cvulkan_generations_total counter\n";
+    out << "cvulkan_generations_total " << c.generations.load(relaxed) << "\n";
+    out << "# TYPE cvulkan_generations_per_second gauge\n";
+    out << "cvulkan_generations_per_second " << c.generationsPerSecond.load(relaxed) << "\n";
+    out << "# HELP cvulkan_submit_seconds Host time of the last frame submit\n";
+    out << "# TYPE cvulkan_submit_seconds gauge\n";
+    out << "cvulkan_submit_seconds " << c.submitSeconds.load(relaxed) << "\n";
+    out << "# HELP cvulkan_frame_wait_seconds Host time waited for the previous frame\n";
+    out << "# TYPE cvulkan_frame_wait_seconds gauge\n";
+    out << "cvulkan_frame_wait_seconds " << c.frameWaitSeconds.load(relaxed) << "\n";
+
+    out << "# HELP cvulkan_stage_gpu_seconds GPU time of a pass in the last measured generation\n";
+    out << "# TYPE cvulkan_stage_gpu_seconds gauge\n";
+    for (const auto& stage : c.stages) {
+        const char* name = stage.name.load(std::memory_order_acquire);
+        if (name == nullptr) {
+            break;
+        }
+        out << "cvulkan_stage_gpu_seconds{stage=\"" << name << "\"} " << stage.seconds.load(relaxed) << "\n";
+    }
+
+    const uint32_t nrGoals = c.nrGoals.load(std::memory_order_acquire);
+    out << "# TYPE cvulkan_best_fitness gauge\n";
+    for (uint32_t goal=0; goal<nrGoals; goal++) {
+        out << "cvulkan_best_fitness{goal=\"" << goal << "\"} " << c.goals[goal].bestFitness.load(relaxed) << "\n";
+    }
+    out << "# TYPE cvulkan_mean_fitness gauge\n";
+    for (uint32_t goal=0; goal<nrGoals; goal++) {
+        out << "cvulkan_mean_fitness{goal=\"" << goal << "\"} " << c.goals[goal].meanFitness.load(relaxed) << "\n";
+    }
+
+    const uint32_t nrHeaps = c.nrHeaps.load(std::memory_order_acquire);
+    out << "# HELP cvulkan_memory_usage_bytes Per heap usage as reported to VMA\n";
+    out << "# TYPE cvulkan_memory_usage_bytes gauge\n";
+    for (uint32_t heap=0; heap<nrHeaps; heap++) {
+        out << "cvulkan_memory_usage_bytes{heap=\"" << heap << "\"} " << c.heaps[heap].usage.load(relaxed) << "\n";
+    }
+    out << "# TYPE cvulkan_memory_budget_bytes gauge\n";
+    for (uint32_t heap=0; heap<nrHeaps; heap++) {
+        out << "cvulkan_memory_budget_bytes{heap=\"" << heap << "\"} " << c.heaps[heap].budget.load(relaxed) << "\n";
+    }
+    return out.str();
+}
@@ -0,0 +1,168 @@
+#include <Overdraw.h>
+
+void _clearBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer);
+size_t _histogramsSize(const OverdrawInfo& info);
+
+Overdraw overdrawCreate(Ctx& ctx, OverdrawInfo& info) {
+    assert(info.instanceWidth % 16 == 0 && info.instanceHeight % 16 == 0);
+    Overdraw ret{};
+    ret.info = info;
+    const bool variableLength = info.drawBuffers[0] != nullptr;
+
+    CompInfo compInfo {
+        .compShader = "overdraw.comp",
+        .bindingDescription = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        },
+        .specializationConstants = { info.nrTrianglesPerInstance, info.instanceWidth, info.instanceHeight, variableLength },
+    };
+    ret.pipeline = compCreate(ctx, compInfo);
+
+    const size_t histogramsSize = _histogramsSize(info);
+    ret.histograms = buffertools::createBufferD(ctx,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            histogramsSize);
+    ret.histogramsReadback = buffertools::createBufferH(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT, histogramsSize);
+
+    for (uint32_t i=0; i<2; i++) {
+        CompResourceBindings bindings {
+            { 0, info.vertexBuffers[i]->buffer },
+            // only has to be valid for fixed length genomes
+            { 1, variableLength ? info.drawBuffers[i]->buffer : info.vertexBuffers[i]->buffer },
+            { 2, ret.histograms.buffer },
+        };
+        ret.descriptorSets[i] = compCreateDescriptorSet(ctx, ret.pipeline, bindings);
+    }
+
+    return ret;
+}
+
+void overdrawDestroy(Ctx& ctx, Overdraw& overdraw) {
+    compDestroy(ctx, overdraw.pipeline);
+    buffertools::destroyBuffer(ctx, overdraw.histograms);
+    buffertools::destroyBuffer(ctx, overdraw.histogramsReadback);
+}
+
+void overdrawRecord(Ctx& ctx, Overdraw& overdraw) {
+    const auto& info = overdraw.info;
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    vkCmdFillBuffer(cmdBuffer, overdraw.histograms.buffer, 0, VK_WHOLE_SIZE, 0);
+    _clearBarrier(ctx, cmdBuffer);
+
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, overdraw.pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, overdraw.pipeline.pipelineLayout, 0, 1, &overdraw.descriptorSets[ctx.frameCtx.frameIdx%2], 0, nullptr);
+    vkCmdDispatch(cmdBuffer, info.instanceWidth/16, info.instanceHeight/16, info.nrInstances);
+}
+
+void overdrawAddPasses(Ctx& ctx, RenderGraph& graph, Overdraw& overdraw) {
+    const auto& info = overdraw.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto read = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+
+    GraphPass pass {
+        .name = "overdraw",
+        .uses = {
+            { .buffer = info.vertexBuffers[frame]->buffer, .stage = stage, .access = read },
+            // cleared first, the barrier after the clear stays inside the pass
+            { .buffer = overdraw.histograms.buffer, .stage = stage | VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR,
+                .access = read | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&overdraw](Ctx& ctx) { overdrawRecord(ctx, overdraw); },
+    };
+    if (info.drawBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.drawBuffers[frame]->buffer, .stage = stage, .access = read });
+    }
+    renderGraphAddPass(graph, pass);
+
+    renderGraphAddPass(graph, GraphPass {
+        .name = "overdraw_readback",
+        .uses = {
+            { .buffer = overdraw.histograms.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR },
+            { .buffer = overdraw.histogramsReadback.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&overdraw](Ctx& ctx) {
+            VkBufferCopy copyRegion{};
+            copyRegion.size = _histogramsSize(overdraw.info);
+            vkCmdCopyBuffer(ctx.frameCtx.cmdBuffer, overdraw.histograms.buffer, overdraw.histogramsReadback.buffer, 1, &copyRegion);
+        },
+    });
+    // Records nothing, only makes the copy visible to the host after the frame fence
+    renderGraphAddPass(graph, GraphPass {
+        .name = "overdraw_host_read",
+        .uses = {
+            { .buffer = overdraw.histogramsReadback.buffer, .stage = VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+                .access = VK_ACCESS_2_HOST_READ_BIT_KHR },
+        },
+        .record = [](Ctx&) {},
+    });
+}
+
+std::vector<uint32_t> overdrawHistograms(Ctx& ctx, Overdraw& overdraw) {
+    const size_t size = _histogramsSize(overdraw.info);
+    std::vector<uint32_t> ret(size / sizeof(uint32_t));
+    void* data;
+    vkCheck(vmaMapMemory(ctx.allocator, overdraw.histogramsReadback.memory, &data));
+    vmaInvalidateAllocation(ctx.allocator, overdraw.histogramsReadback.memory, 0, size);
+    memcpy(ret.data(), data, size);
+    vmaUnmapMemory(ctx.allocator, overdraw.histogramsReadback.memory);
+    return ret;
+}
+
+OverdrawSummary overdrawSummarize(const std::vector<uint64_t>& bins) {
+    OverdrawSummary ret{};
+    uint64_t pixels = 0;
+    uint64_t covered = 0;
+    for (uint32_t i=0; i<bins.size(); i++) {
+        pixels += bins[i];
+        covered += i * bins[i];
+        if (bins[i] > 0) {
+            ret.max = i;
+        }
+    }
+    if (pixels == 0) {
+        return ret;
+    }
+    ret.mean = covered / double(pixels);
+
+    uint64_t seen = 0;
+    bool medianFound = false;
+    for (uint32_t i=0; i<bins.size(); i++) {
+        seen += bins[i];
+        if (!medianFound && 2 * seen >= pixels) {
+            ret.median = i;
+            medianFound = true;
+        }
+        if (100 * seen >= 99 * pixels) {
+            ret.p99 = i;
+            break;
+        }
+    }
+    return ret;
+}
+
+// Private implementation
+
+void _clearBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer) {
+    VkMemoryBarrier2KHR barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR,
+        .srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+    };
+    VkDependencyInfoKHR dependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    ctx.cmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+}
+
+size_t _histogramsSize(const OverdrawInfo& info) {
+    return size_t(info.nrInstances) * (info.nrTrianglesPerInstance + 1) * sizeof(uint32_t);
+}
@@ -0,0 +1,168 @@
+#include <Plateau.h>
+
+// Push constants of plateau.comp
+struct PlateauArgs {
+    float targetFitness;
+    float minImprovement;
+    uint32_t window;
+    uint32_t maxGenerations;
+};
+
+PlateauState _initialState();
+
+Plateau plateauCreate(Ctx& ctx, PlateauInfo& info) {
+    assert(info.nrInstances % info.nrInstancesPerGoal == 0);
+    assert(info.window > 0);
+    Plateau ret{};
+    ret.info = info;
+    ret.nrGoals = info.nrInstances / info.nrInstancesPerGoal;
+
+    ReduceInfo reduceInfo {
+        .mode = REDUCE_MODE_REDUCE,
+        .op = REDUCE_OP_MAX,
+        .type = REDUCE_TYPE_FLOAT,
+        .input = info.scoreBuffer,
+        .segmentSize = info.nrInstancesPerGoal,
+        .nrSegments = ret.nrGoals,
+    };
+    ret.bests = reduceCreate(ctx, reduceInfo);
+    reduceInfo.op = REDUCE_OP_ADD;
+    ret.sums = reduceCreate(ctx, reduceInfo);
+
+    auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PlateauArgs), 0);
+    CompInfo compInfo {
+        .compShader = "plateau.comp",
+        .bindingDescription = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        },
+        .pushConstantRange = &pushConstant,
+        .specializationConstants = { ret.nrGoals, info.nrInstancesPerGoal, info.pixelsPerInstance },
+    };
+    ret.pipeline = compCreate(ctx, compInfo);
+
+    std::vector<PlateauState> states(ret.nrGoals, _initialState());
+    const size_t statesSize = states.size() * sizeof(PlateauState);
+    ret.states = buffertools::createBufferD_Data(ctx,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            statesSize, states.data());
+    ret.statesReadback = buffertools::createBufferH_Data(ctx, VK_BUFFER_USAGE_TRANSFER_DST_BIT, statesSize, states.data());
+
+    CompResourceBindings bindings {
+        { 0, ret.bests.output.buffer },
+        { 1, ret.sums.output.buffer },
+        { 2, ret.states.buffer },
+    };
+    ret.descriptorSet = compCreateDescriptorSet(ctx, ret.pipeline, bindings);
+
+    return ret;
+}
+
+void plateauDestroy(Ctx& ctx, Plateau& plateau) {
+    reduceDestroy(ctx, plateau.bests);
+    reduceDestroy(ctx, plateau.sums);
+    compDestroy(ctx, plateau.pipeline);
+    buffertools::destroyBuffer(ctx, plateau.states);
+    buffertools::destroyBuffer(ctx, plateau.statesReadback);
+}
+
+void plateauRecord(Ctx& ctx, Plateau& plateau) {
+    const auto& info = plateau.info;
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    PlateauArgs args {
+        .targetFitness = info.targetFitness,
+        .minImprovement = info.minImprovement,
+        .window = info.window,
+        .maxGenerations = info.maxGenerations,
+    };
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, plateau.pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, plateau.pipeline.pipelineLayout, 0, 1, &plateau.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, plateau.pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PlateauArgs), &args);
+    vkCmdDispatch(cmdBuffer, plateau.nrGoals/64+1, 1, 1);
+}
+
+void plateauAddPasses(Ctx& ctx, RenderGraph& graph, Plateau& plateau) {
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto read = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR;
+
+    reduceAddPass(ctx, graph, plateau.bests);
+    reduceAddPass(ctx, graph, plateau.sums);
+    renderGraphAddPass(graph, GraphPass {
+        .name = "plateau",
+        .uses = {
+            { .buffer = plateau.bests.output.buffer, .stage = stage, .access = read },
+            { .buffer = plateau.sums.output.buffer, .stage = stage, .access = read },
+            { .buffer = plateau.states.buffer, .stage = stage, .access = read | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR },
+        },
+        .record = [&plateau](Ctx& ctx) { plateauRecord(ctx, plateau); },
+    });
+
+    renderGraphAddPass(graph, GraphPass {
+        .name = "plateau_readback",
+        .uses = {
+            { .buffer = plateau.states.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR },
+            { .buffer = plateau.statesReadback.buffer, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR },
+        },
+        .record = [&plateau](Ctx& ctx) {
+            VkBufferCopy copyRegion{};
+            copyRegion.size = plateau.nrGoals * sizeof(PlateauState);
+            vkCmdCopyBuffer(ctx.frameCtx.cmdBuffer, plateau.states.buffer, plateau.statesReadback.buffer, 1, &copyRegion);
+        },
+    });
+    // Records nothing, only makes the copy visible to the host after the frame fence
+    renderGraphAddPass(graph, GraphPass {
+        .name = "plateau_host_read",
+        .uses = {
+            { .buffer = plateau.statesReadback.buffer, .stage = VK_PIPELINE_STAGE_2_HOST_BIT_KHR,
+                .access = VK_ACCESS_2_HOST_READ_BIT_KHR },
+        },
+        .record = [](Ctx&) {},
+    });
+}
+
+std::vector<PlateauState> plateauPoll(Ctx& ctx, Plateau& plateau) {
+    const size_t size = plateau.nrGoals * sizeof(PlateauState);
+    std::vector<PlateauState> ret(plateau.nrGoals);
+    void* data;
+    vkCheck(vmaMapMemory(ctx.allocator, plateau.statesReadback.memory, &data));
+    vmaInvalidateAllocation(ctx.allocator, plateau.statesReadback.memory, 0, size);
+    memcpy(ret.data(), data, size);
+    vmaUnmapMemory(ctx.allocator, plateau.statesReadback.memory);
+    return ret;
+}
+
+void plateauReset(Ctx& ctx, Plateau& plateau, uint32_t goal) {
+    assert(goal < plateau.nrGoals);
+    PlateauState state = _initialState();
+    buffertools::uploadBufferD(ctx, plateau.states, goal * sizeof(PlateauState), sizeof(PlateauState), &state);
+}
+
+float plateauFitness(const Plateau& plateau, float score) {
+    // the grader accumulates on top of a base score of 1
+    return (score - 1.0f) / plateau.info.pixelsPerInstance;
+}
+
+const char* plateauStatusName(PlateauStatus status) {
+    switch (status) {
+        case PLATEAU_RUNNING: return "running";
+        case PLATEAU_TARGET: return "reached the target";
+        case PLATEAU_STALLED: return "stalled";
+        case PLATEAU_BUDGET: return "out of generations";
+    }
+    return "unknown";
+}
+
+// Private implementation
+
+PlateauState _initialState() {
+    // an empty canvas scores at least the base of 1
+    return PlateauState {
+        .best = 1.0f,
+        .mean = 1.0f,
+        .windowBest = 1.0f,
+        .status = PLATEAU_RUNNING,
+    };
+}
@@ -0,0 +1,186 @@
+#include <Presenter.h>
+
+VkSemaphore _createTimeline(Ctx& ctx);
+void _presentLoop(Ctx& ctx, QuadRender quadRender, VkSemaphore snapshotTimeline, VkSemaphore shownTimeline, PresenterThread& t);
+
+Presenter presenterCreate(Ctx& ctx, PresenterInfo& info) {
+    assert(ctx.info.detachedPresent && !ctx.info.headless);
+    Presenter presenter{ .info = info };
+
+    presenter.snapshot = createImageD(ctx, info.source->width, info.source->height,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            info.source->format, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    QuadRenderInfo quadRenderInfo {
+        .srcImage = presenter.snapshot,
+        .beforeLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    presenter.quadRender = quadRenderCreate(ctx, quadRenderInfo);
+
+    presenter.snapshotTimeline = _createTimeline(ctx);
+    presenter.shownTimeline = _createTimeline(ctx);
+
+    presenter.presentThread = std::make_unique<PresenterThread>();
+    auto& t = *presenter.presentThread;
+    auto poolInfo = vks::initializers::commandPoolCreateInfo(ctx.queues.graphicsFamily);
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    vkCheck(vkCreateCommandPool(ctx.device, &poolInfo, nullptr, &t.commandPool));
+    auto allocInfo = vks::initializers::commandBufferAllocateInfo(t.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+    vkCheck(vkAllocateCommandBuffers(ctx.device, &allocInfo, &t.cmdBuffer));
+
+    auto semInfo = vks::initializers::semaphoreCreateInfo();
+    vkCheck(vkCreateSemaphore(ctx.device, &semInfo, nullptr, &t.imageAvailable));
+    vkCheck(vkCreateSemaphore(ctx.device, &semInfo, nullptr, &t.renderFinished));
+    auto fenceInfo = vks::initializers::fenceCreateInfo(VK_FENCE_CREATE_SIGNALED_BIT);
+    vkCheck(vkCreateFence(ctx.device, &fenceInfo, nullptr, &t.fence));
+
+    // The thread only keeps plain handles, so the Presenter itself may still be moved
+    t.running = true;
+    t.thread = std::thread(_presentLoop, std::ref(ctx), presenter.quadRender,
+            presenter.snapshotTimeline, presenter.shownTimeline, std::ref(t));
+    return presenter;
+}
+
+void presenterStop(Ctx& ctx, Presenter& presenter) {
+    auto& t = *presenter.presentThread;
+    if (!t.thread.joinable()) {
+        return;
+    }
+    t.running = false;
+    t.thread.join();
+    vkCheck(vkWaitForFences(ctx.device, 1, &t.fence, VK_TRUE, UINT64_MAX));
+}
+
+void presenterDestroy(Ctx& ctx, Presenter& presenter) {
+    presenterStop(ctx, presenter);
+    auto& t = *presenter.presentThread;
+    vkDestroyFence(ctx.device, t.fence, nullptr);
+    vkDestroySemaphore(ctx.device, t.renderFinished, nullptr);
+    vkDestroySemaphore(ctx.device, t.imageAvailable, nullptr);
+    vkDestroyCommandPool(ctx.device, t.commandPool, nullptr);
+    presenter.presentThread.reset();
+
+    vkDestroySemaphore(ctx.device, presenter.shownTimeline, nullptr);
+    vkDestroySemaphore(ctx.device, presenter.snapshotTimeline, nullptr);
+    quadRenderDestroy(ctx, presenter.quadRender);
+    destroyImage(ctx, presenter.snapshot);
+}
+
+bool presenterAddPasses(Ctx& ctx, RenderGraph& graph, Presenter& presenter) {
+    double now = glfwGetTime();
+    if (now - presenter.lastSnapshot < presenter.info.interval) {
+        return false;
+    }
+    // Rather skip a snapshot than wait for the display
+    uint64_t shown;
+    vkCheck(vkGetSemaphoreCounterValue(ctx.device, presenter.shownTimeline, &shown));
+    if (shown < presenter.snapshotValue) {
+        return false;
+    }
+    presenter.lastSnapshot = now;
+    presenter.snapshotValue++;
+
+    const Image& source = *presenter.info.source;
+    renderGraphAddPass(graph, GraphPass {
+        .name = "snapshot",
+        .uses = {
+            { .image = &source, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL },
+            { .image = &presenter.snapshot, .stage = VK_PIPELINE_STAGE_2_COPY_BIT_KHR,
+                .access = VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR, .layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, .discard = true },
+        },
+        .record = [&presenter](Ctx& ctx) {
+            VkImageCopy region {
+                .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+                .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+                .extent = { presenter.snapshot.width, presenter.snapshot.height, 1 },
+            };
+            vkCmdCopyImage(ctx.frameCtx.cmdBuffer,
+                    presenter.info.source->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    presenter.snapshot.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        },
+    });
+    // Records nothing, hands the snapshot over in the layout the quad samples it in
+    renderGraphAddPass(graph, GraphPass {
+        .name = "snapshot_release",
+        .uses = {
+            { .image = &presenter.snapshot, .stage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        },
+        .record = [](Ctx&) {},
+    });
+    ctxFrameSignal(ctx, presenter.snapshotTimeline, presenter.snapshotValue);
+    return true;
+}
+
+// Private implementation
+VkSemaphore _createTimeline(Ctx& ctx) {
+    VkSemaphoreTypeCreateInfo typeInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    auto semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+    semaphoreInfo.pNext = &typeInfo;
+    VkSemaphore ret;
+    vkCheck(vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &ret));
+    return ret;
+}
+
+void _presentLoop(Ctx& ctx, QuadRender quadRender, VkSemaphore snapshotTimeline, VkSemaphore shownTimeline, PresenterThread& t) {
+    uint64_t shown = 0;
+    while (t.running) {
+        uint64_t next = shown + 1;
+        VkSemaphoreWaitInfo waitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &snapshotTimeline,
+            .pValues = &next,
+        };
+        // Wakes up every 100ms to notice a stop
+        if (vkWaitSemaphores(ctx.device, &waitInfo, 100'000'000) == VK_TIMEOUT) {
+            continue;
+        }
+
+        vkCheck(vkWaitForFences(ctx.device, 1, &t.fence, VK_TRUE, UINT64_MAX));
+        vkCheck(vkResetFences(ctx.device, 1, &t.fence));
+        uint32_t imageIdx;
+        vkCheck(vkAcquireNextImageKHR(ctx.device, ctx.window.swapchain, UINT64_MAX, t.imageAvailable, VK_NULL_HANDLE, &imageIdx));
+
+        vkCheck(vkResetCommandBuffer(t.cmdBuffer, 0));
+        auto beginInfo = vks::initializers::commandBufferBeginInfo();
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkCheck(vkBeginCommandBuffer(t.cmdBuffer, &beginInfo));
+        quadRenderRecord(ctx, quadRender, t.cmdBuffer, imageIdx);
+        vkCheck(vkEndCommandBuffer(t.cmdBuffer));
+
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        VkSemaphore signalSemaphores[] = { t.renderFinished, shownTimeline };
+        // the first value is ignored, renderFinished is binary
+        uint64_t signalValues[] = { 0, next };
+        VkTimelineSemaphoreSubmitInfo timelineInfo {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .signalSemaphoreValueCount = 2,
+            .pSignalSemaphoreValues = signalValues,
+        };
+        auto submitInfo = vks::initializers::submitInfo(&t.cmdBuffer);
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &t.imageAvailable;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.signalSemaphoreCount = 2;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+        ctxQueueSubmit(ctx, ctx.queues.graphics, submitInfo, t.fence);
+
+        VkPresentInfoKHR presentInfo {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &t.renderFinished,
+            .swapchainCount = 1,
+            .pSwapchains = &ctx.window.swapchain,
+            .pImageIndices = &imageIdx,
+        };
+        vkCheck(ctxQueuePresent(ctx, presentInfo));
+        shown = next;
+    }
+}
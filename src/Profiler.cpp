@@ -0,0 +1,148 @@
+#include <Profiler.h>
+
+bool _readQueries(Ctx& ctx, VkQueryPool pool, uint32_t count, uint32_t valuesPerQuery, std::vector<uint64_t>& values);
+
+Profiler profilerCreate(Ctx& ctx, ProfilerInfo& info) {
+    Profiler ret{ .info = info };
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx.physicalDevice, &properties);
+
+    if (info.statistics && !ctx.pipelineStatistics) {
+        logger::warn("The device does not support pipeline statistics queries");
+    }
+    if (info.statistics && ctx.pipelineStatistics) {
+        VkQueryPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = info.maxScopes,
+            .pipelineStatistics = profilerStatistics,
+        };
+        vkCheck(vkCreateQueryPool(ctx.device, &poolInfo, nullptr, &ret.statisticsPool));
+    }
+
+    if (properties.limits.timestampComputeAndGraphics) {
+        VkQueryPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2 * info.maxScopes,
+        };
+        vkCheck(vkCreateQueryPool(ctx.device, &poolInfo, nullptr, &ret.timestampPool));
+        ret.timestampPeriod = properties.limits.timestampPeriod * 1e-9;
+    } else {
+        logger::warn("The device has no timestamps on every queue, passes are not timed");
+    }
+
+    return ret;
+}
+
+void profilerDestroy(Ctx& ctx, Profiler& profiler) {
+    if (profiler.statisticsPool) {
+        vkDestroyQueryPool(ctx.device, profiler.statisticsPool, nullptr);
+    }
+    if (profiler.timestampPool) {
+        vkDestroyQueryPool(ctx.device, profiler.timestampPool, nullptr);
+    }
+}
+
+void profilerBeginFrame(Ctx& ctx, Profiler& profiler) {
+    profiler.scopes.clear();
+    if (profiler.statisticsPool) {
+        vkCmdResetQueryPool(ctx.frameCtx.cmdBuffer, profiler.statisticsPool, 0, profiler.info.maxScopes);
+    }
+    if (profiler.timestampPool) {
+        vkCmdResetQueryPool(ctx.frameCtx.cmdBuffer, profiler.timestampPool, 0, 2 * profiler.info.maxScopes);
+    }
+}
+
+void profilerBeginScope(Ctx& ctx, Profiler& profiler, const char* name) {
+    // The queries of another scope would land past the end of the pools
+    if (profiler.scopes.size() >= profiler.info.maxScopes) {
+        logger::crash(fmt::format("More than {} passes in a profiled frame, raise ProfilerInfo::maxScopes", profiler.info.maxScopes));
+    }
+    const uint32_t scope = profiler.scopes.size();
+    if (profiler.timestampPool) {
+        vkCmdWriteTimestamp(ctx.frameCtx.cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler.timestampPool, 2 * scope);
+    }
+    if (profiler.statisticsPool) {
+        vkCmdBeginQuery(ctx.frameCtx.cmdBuffer, profiler.statisticsPool, scope, 0);
+    }
+    profiler.scopes.push_back(name);
+}
+
+void profilerEndScope(Ctx& ctx, Profiler& profiler) {
+    assert(!profiler.scopes.empty());
+    const uint32_t scope = profiler.scopes.size() - 1;
+    if (profiler.statisticsPool) {
+        vkCmdEndQuery(ctx.frameCtx.cmdBuffer, profiler.statisticsPool, scope);
+    }
+    if (profiler.timestampPool) {
+        vkCmdWriteTimestamp(ctx.frameCtx.cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler.timestampPool, 2 * scope + 1);
+    }
+}
+
+std::vector<ProfilerScope> profilerResults(Ctx& ctx, Profiler& profiler) {
+    std::vector<ProfilerScope> ret;
+    if (profiler.scopes.empty()) {
+        return ret;
+    }
+    const uint32_t nrScopes = profiler.scopes.size();
+
+    // The counters of a query come in the bit order of profilerStatistics
+    constexpr uint32_t nrCounters = 5;
+    std::vector<uint64_t> counters(nrScopes * nrCounters, 0);
+    std::vector<uint64_t> timestamps(2 * nrScopes, 0);
+    bool ready = true;
+    if (profiler.statisticsPool) {
+        ready = _readQueries(ctx, profiler.statisticsPool, nrScopes, nrCounters, counters) && ready;
+    }
+    if (profiler.timestampPool) {
+        ready = _readQueries(ctx, profiler.timestampPool, 2 * nrScopes, 1, timestamps) && ready;
+    }
+    if (!ready) {
+        logger::warn("Profiler queries were not ready after the frame fence");
+        profiler.scopes.clear();
+        return ret;
+    }
+
+    for (uint32_t i=0; i<nrScopes; i++) {
+        const uint64_t* c = &counters[i * nrCounters];
+        ret.push_back(ProfilerScope {
+            .name = profiler.scopes[i],
+            .seconds = (timestamps[2*i+1] - timestamps[2*i]) * profiler.timestampPeriod,
+            .inputPrimitives = c[0],
+            .vertexInvocations = c[1],
+            .clippingPrimitives = c[2],
+            .fragmentInvocations = c[3],
+            .computeInvocations = c[4],
+        });
+    }
+    profiler.scopes.clear();
+    return ret;
+}
+
+void profilerLog(const std::vector<ProfilerScope>& scopes) {
+    for (const auto& scope : scopes) {
+        if (scope.seconds > 0.0) {
+            logger::info("Profile {}: {:.3f} ms", scope.name, 1e3 * scope.seconds);
+        }
+        if (scope.inputPrimitives > 0 || scope.fragmentInvocations > 0) {
+            logger::info("Profile {}: {} primitives in, {} vertex invocations, {} primitives rasterized, {} fragment invocations",
+                    scope.name, scope.inputPrimitives, scope.vertexInvocations, scope.clippingPrimitives, scope.fragmentInvocations);
+        }
+        if (scope.computeInvocations > 0) {
+            logger::info("Profile {}: {} compute invocations", scope.name, scope.computeInvocations);
+        }
+    }
+}
+
+// Private implementation
+
+bool _readQueries(Ctx& ctx, VkQueryPool pool, uint32_t count, uint32_t valuesPerQuery, std::vector<uint64_t>& values) {
+    VkResult result = vkGetQueryPoolResults(ctx.device, pool, 0, count, values.size() * sizeof(uint64_t), values.data(),
+            valuesPerQuery * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result == VK_NOT_READY) {
+        return false;
+    }
+    vkCheck(result);
+    return true;
+}
@@ -1,7 +1,7 @@
 #include <QuadRender.h>
 
 QuadRender quadRenderCreate(Ctx& ctx, QuadRenderInfo& info) {
-    QuadRender quadRender{};
+    QuadRender quadRender{ .info = info };
 
     RenderPassInfo renderPassInfo {
         .beforeLayout = info.beforeLayout,
@@ -21,16 +21,16 @@ QuadRender quadRenderCreate(Ctx& ctx, QuadRenderInfo& info) {
     auto descriptorLayoutInfo = vks::initializers::descriptorSetLayoutCreateInfo(&textBinding, 1);
     vkCheck(vkCreateDescriptorSetLayout(ctx.device, &descriptorLayoutInfo, nullptr, &quadRender.descriptorLayout));
 
-    auto allocInfo = vks::initializers::descriptorSetAllocateInfo(ctx.descriptorPool, &quadRender.descriptorLayout, 1);
-    vkCheck(vkAllocateDescriptorSets(ctx.device, &allocInfo, &quadRender.descriptorSet));
+    quadRender.descriptorSet = ctxAllocDescriptorSet(ctx, quadRender.descriptorLayout);
 
-    auto imageInfo = vks::initializers::descriptorImageInfo(quadRender.sampler, info.srcImage.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    quadRender.srcView = createImageLayerView(ctx, info.srcImage, 0);
+    auto imageInfo = vks::initializers::descriptorImageInfo(quadRender.sampler, quadRender.srcView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
     auto writeInfo = vks::initializers::writeDescriptorSet(quadRender.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0, &imageInfo);
     vkUpdateDescriptorSets(ctx.device, 1, &writeInfo, 0, nullptr);
 
     RastPipelineInfo rastInfo {
-        .vsPath = "./shaders_bin/quad.vert.spv",
-        .fsPath = "./shaders_bin/quad.frag.spv",
+        .vertShader = "quad.vert",
+        .fragShader = "quad.frag",
         .renderPass = &quadRender.renderPass,
         .descriptorSetLayouts = {quadRender.descriptorLayout},
     };
@@ -41,18 +41,21 @@ QuadRender quadRenderCreate(Ctx& ctx, QuadRenderInfo& info) {
 
 void quadRenderDestroy(Ctx& ctx, QuadRender& quadRender) {
     vkDestroySampler(ctx.device, quadRender.sampler, nullptr);
+    vkDestroyImageView(ctx.device, quadRender.srcView, nullptr);
     vkDestroyDescriptorSetLayout(ctx.device, quadRender.descriptorLayout, nullptr);
     rastPipelineDestroy(ctx, quadRender.pipeline);
     renderPassDestroy(ctx, quadRender.renderPass);
 }
 
 void quadRenderRecord(Ctx& ctx, QuadRender& quadRender) {
-    VkCommandBuffer cmdBuffer = ctx.frameCtx.cmdBuffer;
+    quadRenderRecord(ctx, quadRender, ctx.frameCtx.cmdBuffer, ctx.frameCtx.imageIdx);
+}
 
+void quadRenderRecord(Ctx& ctx, QuadRender& quadRender, VkCommandBuffer cmdBuffer, uint32_t imageIdx) {
     VkClearValue clearColor { .color = {0.0f, 0.0f, 0.0f, 0.0f}, };
     auto renderPassInfo = vks::initializers::renderPassBeginInfo(
             quadRender.renderPass.renderPass,
-            quadRender.renderPass.framebuffers[ctx.frameCtx.imageIdx]);
+            quadRender.renderPass.framebuffers[imageIdx]);
     renderPassInfo.renderArea.extent = {ctx.window.width,ctx.window.height};
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
@@ -62,5 +65,15 @@ void quadRenderRecord(Ctx& ctx, QuadRender& quadRender) {
     vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, quadRender.pipeline.pipelineLayout, 0, 1, &quadRender.descriptorSet, 0, nullptr);
     vkCmdDraw(cmdBuffer, 3, 1, 0, 0);
     vkCmdEndRenderPass(cmdBuffer);
-} 
+}
 
+void quadRenderAddPass(Ctx& ctx, RenderGraph& graph, QuadRender& quadRender) {
+    renderGraphAddPass(graph, GraphPass {
+        .name = "quad_render",
+        .uses = {
+            { .image = &quadRender.info.srcImage, .stage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR,
+                .access = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
+        },
+        .record = [&quadRender](Ctx& ctx) { quadRenderRecord(ctx, quadRender); },
+    });
+}
@@ -1,8 +1,9 @@
 #include <Rast.h>
+#include <Shaders.h>
 
 void _ensureInfoComplete(const RastPipelineInfo& info) {
-    assert(info.fsPath);
-    assert(info.vsPath);
+    assert(info.fragShader);
+    assert(info.vertShader);
     assert(info.renderPass);
 }
 
@@ -19,13 +20,18 @@ RastPipeline rastPipelineCreate(const Ctx& ctx, const RastPipelineInfo& info) {
     vkCheck(vkCreatePipelineLayout(ctx.device, &pipelineLayoutInfo, nullptr, &ret.pipelineLayout));
 
 
-    logger::debug("Loading vertex shader: {}", info.vsPath);
-    auto vertShader = vks::tools::loadShader(info.vsPath, ctx.device);
-    logger::debug("Loading fragment shader: {}", info.fsPath);
-    auto fragShader = vks::tools::loadShader(info.fsPath, ctx.device);
+    logger::debug("Loading vertex shader: {}", info.vertShader);
+    auto vertShader = shaders::createModule(ctx.device, info.vertShader);
+    logger::debug("Loading fragment shader: {}", info.fragShader);
+    auto fragShader = shaders::createModule(ctx.device, info.fragShader);
+
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    auto specialization = shaders::specializationInfo(info.specializationConstants, specializationEntries);
 
     auto vertStage = vks::initializers::pipelineShaderStageCreateInfo(vertShader, VK_SHADER_STAGE_VERTEX_BIT);
     auto fragStage = vks::initializers::pipelineShaderStageCreateInfo(fragShader, VK_SHADER_STAGE_FRAGMENT_BIT);
+    vertStage.pSpecializationInfo = &specialization;
+    fragStage.pSpecializationInfo = &specialization;
     
     std::array<VkPipelineShaderStageCreateInfo,2> stages { vertStage, fragStage };
 
@@ -44,8 +50,12 @@ RastPipeline rastPipelineCreate(const Ctx& ctx, const RastPipelineInfo& info) {
             VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, 0, VK_FALSE);
 
     // Viewport & Scissors
-    auto viewPort = vks::initializers::viewport(ctx.window.width, ctx.window.height, 0.0f, 1.0f);
-    auto scissors = vks::initializers::rect2D(ctx.window.width, ctx.window.height, 0, 0);
+    VkExtent2D extent = info.viewport;
+    if (extent.width == 0 || extent.height == 0) {
+        extent = { ctx.window.width, ctx.window.height };
+    }
+    auto viewPort = vks::initializers::viewport(extent.width, extent.height, 0.0f, 1.0f);
+    auto scissors = vks::initializers::rect2D(extent.width, extent.height, 0, 0);
 
     auto viewportState = vks::initializers::pipelineViewportStateCreateInfo(&viewPort, &scissors);
     auto rasterizer = vks::initializers::pipelineRasterizationStateCreateInfo(
@@ -73,7 +83,7 @@ RastPipeline rastPipelineCreate(const Ctx& ctx, const RastPipelineInfo& info) {
     pipelineInfo.pDepthStencilState = nullptr;
     pipelineInfo.pColorBlendState = &colorBlendState;
     pipelineInfo.pDynamicState = nullptr;
-    vkCheck(vkCreateGraphicsPipelines(ctx.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &ret.pipeline));
+    vkCheck(vkCreateGraphicsPipelines(ctx.device, ctx.pipelineCache, 1, &pipelineInfo, nullptr, &ret.pipeline));
     logger::debug("rasterization pipeline created");
 
 
@@ -0,0 +1,204 @@
+#include <Reduce.h>
+
+struct ReducePushConstants {
+    uint32_t nrSegments;
+    uint32_t segmentSize;
+    uint32_t groupsPerSegment;
+};
+
+CompPipeline _createPipeline(Ctx& ctx, const ReduceInfo& info, const char* shader, std::vector<uint32_t> constants);
+void _computeBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer);
+void _dispatch(Ctx& ctx, Reduce& reduce, const CompPipeline& pipeline, VkDescriptorSet descriptorSet, const ReduceLevel& level);
+
+Reduce reduceCreate(Ctx& ctx, ReduceInfo& info) {
+    assert(info.segmentSize > 0 && info.nrSegments > 0);
+    Reduce ret{ .info = info, .input = *info.input };
+    const bool scan = info.mode != REDUCE_MODE_REDUCE;
+    const size_t elementSize = scan ? sizeof(uint32_t) : sizeof(ReducePair);
+
+    ret.ownsOutput = info.output == nullptr;
+    if (ret.ownsOutput) {
+        size_t outputSize = scan ? size_t(info.nrSegments) * info.segmentSize * sizeof(uint32_t) : info.nrSegments * sizeof(ReducePair);
+        ret.output = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, outputSize);
+    } else {
+        ret.output = *info.output;
+    }
+
+    // Every level folds reduceGroupValues of a segment into one value, until one is left
+    uint32_t segmentSize = info.segmentSize;
+    do {
+        ReduceLevel level {
+            .segmentSize = segmentSize,
+            .groupsPerSegment = (segmentSize + reduceGroupValues - 1) / reduceGroupValues,
+        };
+        if (level.groupsPerSegment > 1) {
+            level.partials = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    size_t(info.nrSegments) * level.groupsPerSegment * elementSize);
+        }
+        if (scan && !ret.levels.empty()) {
+            level.scanned = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                    size_t(info.nrSegments) * segmentSize * sizeof(uint32_t));
+        }
+        ret.levels.push_back(level);
+        segmentSize = level.groupsPerSegment;
+    } while (segmentSize > 1);
+    const bool multiLevel = ret.levels.size() > 1;
+
+    if (scan) {
+        const uint32_t exclusive = info.mode == REDUCE_MODE_EXCLUSIVE_SCAN;
+        ret.firstPipeline = _createPipeline(ctx, info, "scan.comp", { info.op, info.type, exclusive, false });
+        if (multiLevel) {
+            ret.levelPipeline = _createPipeline(ctx, info, "scan.comp", { info.op, info.type, true, false });
+            ret.addPipeline = _createPipeline(ctx, info, "scan.comp", { info.op, info.type, exclusive, true });
+        }
+    } else {
+        ret.firstPipeline = _createPipeline(ctx, info, "reduce.comp", { info.op, info.type, true });
+        if (multiLevel) {
+            ret.levelPipeline = _createPipeline(ctx, info, "reduce.comp", { info.op, info.type, false });
+        }
+    }
+
+    // Bindings a level does not use point at its output, they only have to be valid
+    for (size_t i=0; i<ret.levels.size(); i++) {
+        auto& level = ret.levels[i];
+        const bool last = i + 1 == ret.levels.size();
+        if (scan) {
+            Buffer in = i == 0 ? ret.input : ret.levels[i-1].partials;
+            Buffer out = i == 0 ? ret.output : level.scanned;
+            CompResourceBindings bindings {
+                { 0, in.buffer },
+                { 1, out.buffer },
+                { 2, last ? out.buffer : level.partials.buffer },
+                { 3, last ? out.buffer : ret.levels[i+1].scanned.buffer },
+            };
+            level.descriptorSet = compCreateDescriptorSet(ctx, i == 0 ? ret.firstPipeline : ret.levelPipeline, bindings);
+            if (!last) {
+                level.addDescriptorSet = compCreateDescriptorSet(ctx, ret.addPipeline, bindings);
+            }
+        } else {
+            Buffer out = last ? ret.output : level.partials;
+            CompResourceBindings bindings {
+                { 0, i == 0 ? ret.input.buffer : out.buffer },
+                { 1, i == 0 ? out.buffer : ret.levels[i-1].partials.buffer },
+                { 2, out.buffer },
+            };
+            level.descriptorSet = compCreateDescriptorSet(ctx, i == 0 ? ret.firstPipeline : ret.levelPipeline, bindings);
+        }
+    }
+
+    logger::debug("Reduce of {} segments of {} values in {} levels", info.nrSegments, info.segmentSize, ret.levels.size());
+    return ret;
+}
+
+void reduceDestroy(Ctx& ctx, Reduce& reduce) {
+    compDestroy(ctx, reduce.firstPipeline);
+    if (reduce.levels.size() > 1) {
+        compDestroy(ctx, reduce.levelPipeline);
+        if (reduce.info.mode != REDUCE_MODE_REDUCE) {
+            compDestroy(ctx, reduce.addPipeline);
+        }
+    }
+    for (size_t i=0; i<reduce.levels.size(); i++) {
+        auto& level = reduce.levels[i];
+        if (level.groupsPerSegment > 1) {
+            buffertools::destroyBuffer(ctx, level.partials);
+        }
+        if (reduce.info.mode != REDUCE_MODE_REDUCE && i > 0) {
+            buffertools::destroyBuffer(ctx, level.scanned);
+        }
+    }
+    if (reduce.ownsOutput) {
+        buffertools::destroyBuffer(ctx, reduce.output);
+    }
+}
+
+void reduceRecord(Ctx& ctx, Reduce& reduce) {
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    const auto& levels = reduce.levels;
+
+    // Down the levels, every level waits for the partials of the one before
+    for (size_t i=0; i<levels.size(); i++) {
+        if (i > 0) {
+            _computeBarrier(ctx, cmdBuffer);
+        }
+        _dispatch(ctx, reduce, i == 0 ? reduce.firstPipeline : reduce.levelPipeline, levels[i].descriptorSet, levels[i]);
+    }
+    if (reduce.info.mode == REDUCE_MODE_REDUCE) {
+        return;
+    }
+
+    // and back up for the scans, every level needs the finished offsets of the next
+    for (size_t i=levels.size()-1; i-- > 0;) {
+        _computeBarrier(ctx, cmdBuffer);
+        _dispatch(ctx, reduce, reduce.addPipeline, levels[i].addDescriptorSet, levels[i]);
+    }
+}
+
+void reduceAddPass(Ctx& ctx, RenderGraph& graph, Reduce& reduce) {
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto readWrite = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+    GraphPass pass {
+        .name = "reduce",
+        .uses = {
+            { .buffer = reduce.input.buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR },
+            { .buffer = reduce.output.buffer, .stage = stage, .access = readWrite },
+        },
+        .record = [&reduce](Ctx& ctx) { reduceRecord(ctx, reduce); },
+    };
+    // The barriers between the levels stay inside the pass, the graph only orders
+    // the scratch buffers against the previous run of the pass
+    for (size_t i=0; i<reduce.levels.size(); i++) {
+        const auto& level = reduce.levels[i];
+        if (level.groupsPerSegment > 1) {
+            pass.uses.push_back({ .buffer = level.partials.buffer, .stage = stage, .access = readWrite });
+        }
+        if (reduce.info.mode != REDUCE_MODE_REDUCE && i > 0) {
+            pass.uses.push_back({ .buffer = level.scanned.buffer, .stage = stage, .access = readWrite });
+        }
+    }
+    renderGraphAddPass(graph, pass);
+}
+
+// Private implementation
+CompPipeline _createPipeline(Ctx& ctx, const ReduceInfo& info, const char* shader, std::vector<uint32_t> constants) {
+    auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ReducePushConstants), 0);
+    CompInfo compInfo {
+        .compShader = shader,
+        .pushConstantRange = &pushConstant,
+        .specializationConstants = constants,
+    };
+    const uint32_t nrBindings = info.mode == REDUCE_MODE_REDUCE ? 3 : 4;
+    for (uint32_t i=0; i<nrBindings; i++) {
+        compInfo.bindingDescription[i] = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
+    return compCreate(ctx, compInfo);
+}
+
+void _computeBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer) {
+    VkMemoryBarrier2KHR barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR,
+    };
+    VkDependencyInfoKHR dependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    ctx.cmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+}
+
+void _dispatch(Ctx& ctx, Reduce& reduce, const CompPipeline& pipeline, VkDescriptorSet descriptorSet, const ReduceLevel& level) {
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    ReducePushConstants constants {
+        .nrSegments = reduce.info.nrSegments,
+        .segmentSize = level.segmentSize,
+        .groupsPerSegment = level.groupsPerSegment,
+    };
+    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+    vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuffer, pipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstants), &constants);
+    vkCmdDispatch(cmdBuffer, level.groupsPerSegment, reduce.info.nrSegments, 1);
+}
@@ -0,0 +1,289 @@
+#include <Refine.h>
+
+// Triangle t of a genome as seen from one pixel, see shade() in refine.comp
+struct RefineShaded {
+    bool hit;
+    float coverage;
+    glm::vec4 color;
+    glm::vec3 bary;
+    uint32_t edge;
+    float orientation;
+};
+
+void _stepBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer);
+RefineShaded _shade(const RefineInfo& info, const Vertex* triangle, glm::vec2 p);
+void _edgeGradient(glm::vec2 a, glm::vec2 b, glm::vec2 p, float orientation, glm::vec2& da, glm::vec2& db);
+
+Refine refineCreate(Ctx& ctx, RefineInfo& info) {
+    assert(info.instanceWidth % 16 == 0 && info.instanceHeight % 16 == 0);
+    assert(info.nrInstances % info.nrInstancesPerGoal == 0);
+    Refine ret{};
+    ret.info = info;
+    ret.nrGoals = info.nrInstances / info.nrInstancesPerGoal;
+    assert(info.goal->layers >= ret.nrGoals);
+    const bool variableLength = info.drawBuffers[0] != nullptr;
+
+    ReduceInfo reduceInfo {
+        .mode = REDUCE_MODE_REDUCE,
+        .op = REDUCE_OP_MAX,
+        .type = REDUCE_TYPE_FLOAT,
+        .input = info.scoreBuffer,
+        .segmentSize = info.nrInstancesPerGoal,
+        .nrSegments = ret.nrGoals,
+    };
+    ret.champions = reduceCreate(ctx, reduceInfo);
+
+    auto pushConstant = vks::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(RefineArgs), 0);
+    CompInfo compInfo {
+        // compact goals need the variant that reads them without a format
+        .compShader = info.goal->format == VK_FORMAT_R32G32B32A32_SFLOAT ? "refine.comp" : "refine_unformatted.comp",
+        .bindingDescription = {
+            { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE },
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+            { 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER },
+        },
+        .pushConstantRange = &pushConstant,
+        .specializationConstants = {
+            info.nrTrianglesPerInstance,
+            info.instanceWidth,
+            info.instanceHeight,
+            info.nrInstancesPerGoal,
+            ret.nrGoals,
+            variableLength,
+            false,
+        },
+    };
+    ret.gradientPipeline = compCreate(ctx, compInfo);
+    compInfo.specializationConstants[6] = true;
+    ret.adamPipeline = compCreate(ctx, compInfo);
+
+    const size_t parameterSize = size_t(ret.nrGoals) * 3 * info.nrTrianglesPerInstance * sizeof(Vertex);
+    const auto usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    ret.gradients = buffertools::createBufferD(ctx, usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, parameterSize);
+    ret.adamM = buffertools::createBufferD(ctx, usage, parameterSize);
+    ret.adamV = buffertools::createBufferD(ctx, usage, parameterSize);
+
+    for (uint32_t i=0; i<2; i++) {
+        CompResourceBindings bindings {
+            { 0, info.vertexBuffers[i]->buffer },
+            // only has to be valid for fixed length genomes
+            { 1, variableLength ? info.drawBuffers[i]->buffer : info.vertexBuffers[i]->buffer },
+            { 2, ret.champions.output.buffer },
+            { 3, info.goal->view },
+            { 4, ret.gradients.buffer },
+            { 5, ret.adamM.buffer },
+            { 6, ret.adamV.buffer },
+        };
+        ret.gradientDescriptorSets[i] = compCreateDescriptorSet(ctx, ret.gradientPipeline, bindings);
+        ret.adamDescriptorSets[i] = compCreateDescriptorSet(ctx, ret.adamPipeline, bindings);
+    }
+
+    return ret;
+}
+
+void refineDestroy(Ctx& ctx, Refine& refine) {
+    reduceDestroy(ctx, refine.champions);
+    compDestroy(ctx, refine.gradientPipeline);
+    compDestroy(ctx, refine.adamPipeline);
+    buffertools::destroyBuffer(ctx, refine.gradients);
+    buffertools::destroyBuffer(ctx, refine.adamM);
+    buffertools::destroyBuffer(ctx, refine.adamV);
+}
+
+void refineRecord(Ctx& ctx, Refine& refine) {
+    const auto& info = refine.info;
+    auto& cmdBuffer = ctx.frameCtx.cmdBuffer;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const uint32_t nrParameters = refine.nrGoals * 3 * info.nrTrianglesPerInstance * 8;
+
+    // Adam starts over on every refinement, the champions are other genomes by then
+    vkCmdFillBuffer(cmdBuffer, refine.adamM.buffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(cmdBuffer, refine.adamV.buffer, 0, VK_WHOLE_SIZE, 0);
+    for (uint32_t step=1; step<=info.steps; step++) {
+        RefineArgs args {
+            .step = step,
+            .sigma = info.sigma,
+            .positionRate = info.positionRate,
+            .colorRate = info.colorRate,
+        };
+        vkCmdFillBuffer(cmdBuffer, refine.gradients.buffer, 0, VK_WHOLE_SIZE, 0);
+        _stepBarrier(ctx, cmdBuffer);
+
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, refine.gradientPipeline.pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, refine.gradientPipeline.pipelineLayout, 0, 1, &refine.gradientDescriptorSets[frame], 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, refine.gradientPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RefineArgs), &args);
+        vkCmdDispatch(cmdBuffer, info.instanceWidth/16, info.instanceHeight/16, refine.nrGoals);
+        _stepBarrier(ctx, cmdBuffer);
+
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, refine.adamPipeline.pipeline);
+        vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, refine.adamPipeline.pipelineLayout, 0, 1, &refine.adamDescriptorSets[frame], 0, nullptr);
+        vkCmdPushConstants(cmdBuffer, refine.adamPipeline.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(RefineArgs), &args);
+        vkCmdDispatch(cmdBuffer, nrParameters/256+1, 1, 1);
+        if (step < info.steps) {
+            _stepBarrier(ctx, cmdBuffer);
+        }
+    }
+}
+
+void refineAddPasses(Ctx& ctx, RenderGraph& graph, Refine& refine) {
+    const auto& info = refine.info;
+    const uint32_t frame = ctx.frameCtx.frameIdx%2;
+    const auto stage = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR;
+    const auto readWrite = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR;
+
+    reduceAddPass(ctx, graph, refine.champions);
+    GraphPass pass {
+        .name = "refine",
+        .uses = {
+            { .buffer = info.vertexBuffers[frame]->buffer, .stage = stage, .access = readWrite },
+            { .buffer = refine.champions.output.buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR },
+            { .image = info.goal, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR, .layout = VK_IMAGE_LAYOUT_GENERAL },
+        },
+        .record = [&refine](Ctx& ctx) { refineRecord(ctx, refine); },
+    };
+    // the barriers between the steps stay inside the pass
+    for (const Buffer* buffer : { &refine.gradients, &refine.adamM, &refine.adamV }) {
+        pass.uses.push_back({ .buffer = buffer->buffer, .stage = stage | VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR,
+                .access = readWrite | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR });
+    }
+    if (info.drawBuffers[0]) {
+        pass.uses.push_back({ .buffer = info.drawBuffers[frame]->buffer, .stage = stage, .access = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR });
+    }
+    renderGraphAddPass(graph, pass);
+}
+
+std::vector<Vertex> refineDownloadGradients(Ctx& ctx, Refine& refine, uint32_t goal) {
+    assert(goal < refine.nrGoals);
+    const uint32_t nrVertices = 3 * refine.info.nrTrianglesPerInstance;
+    std::vector<Vertex> ret(nrVertices);
+    buffertools::downloadBufferD(ctx, refine.gradients, goal * nrVertices * sizeof(Vertex), nrVertices * sizeof(Vertex), ret.data());
+    return ret;
+}
+
+float refineReferenceGradients(const RefineInfo& info, const Vertex* genome, uint32_t nrTriangles,
+        const float* goal, std::vector<Vertex>& gradients) {
+    gradients.assign(3 * nrTriangles, Vertex{ .pos = glm::vec4(0.0f), .color = glm::vec4(0.0f) });
+    const glm::vec2 scale(info.instanceWidth, info.instanceHeight);
+    const float sqrt3 = std::sqrt(3.0f);
+    std::vector<RefineShaded> shaded(nrTriangles);
+
+    float score = 0.0f;
+    for (uint32_t y=0; y<info.instanceHeight; y++) {
+        for (uint32_t x=0; x<info.instanceWidth; x++) {
+            glm::vec2 p(x + 0.5f, y + 0.5f);
+            glm::vec3 canvas(0.0f);
+            for (uint32_t t=0; t<nrTriangles; t++) {
+                shaded[t] = _shade(info, genome + 3*t, p);
+                if (shaded[t].hit) {
+                    canvas = glm::mix(canvas, glm::vec3(shaded[t].color), shaded[t].color.a * shaded[t].coverage);
+                }
+            }
+
+            const float* target = goal + 4 * (y * info.instanceWidth + x);
+            glm::vec3 delta = glm::vec3(target[0], target[1], target[2]) - canvas;
+            float error = glm::length(delta);
+            score += std::pow(1.0f - error / sqrt3, 5.0f);
+            glm::vec3 dCanvas(0.0f);
+            if (error > 0.0f) {
+                dCanvas = 5.0f * std::pow(1.0f - error / sqrt3, 4.0f) / sqrt3 * delta / error;
+            }
+
+            float transmittance = 1.0f;
+            for (uint32_t t=nrTriangles; t-- > 0;) {
+                const auto& s = shaded[t];
+                if (!s.hit) {
+                    continue;
+                }
+                glm::vec3 rgb(s.color);
+                float w = s.color.a * s.coverage;
+                glm::vec3 before = (canvas - rgb * w) / (1.0f - w);
+                glm::vec3 dOut = dCanvas * transmittance;
+                float dW = glm::dot(dOut, rgb - before);
+                for (uint32_t k=0; k<3; k++) {
+                    gradients[3*t + k].color += s.bary[k] * glm::vec4(dOut * w, dW * s.coverage);
+                }
+
+                float dDistance = dW * s.color.a * s.coverage * (1.0f - s.coverage) / info.sigma;
+                uint32_t a = (s.edge + 1) % 3;
+                uint32_t b = (s.edge + 2) % 3;
+                glm::vec2 da, db;
+                _edgeGradient(glm::vec2(genome[3*t + a].pos) * scale, glm::vec2(genome[3*t + b].pos) * scale, p, s.orientation, da, db);
+                gradients[3*t + a].pos += glm::vec4(dDistance * da * scale, 0.0f, 0.0f);
+                gradients[3*t + b].pos += glm::vec4(dDistance * db * scale, 0.0f, 0.0f);
+
+                transmittance *= 1.0f - w;
+                canvas = before;
+            }
+        }
+    }
+    return score;
+}
+
+// Private implementation
+void _stepBarrier(Ctx& ctx, VkCommandBuffer cmdBuffer) {
+    VkMemoryBarrier2KHR barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR | VK_PIPELINE_STAGE_2_CLEAR_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT_KHR | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+    };
+    VkDependencyInfoKHR dependencyInfo {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    ctx.cmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+}
+
+RefineShaded _shade(const RefineInfo& info, const Vertex* triangle, glm::vec2 p) {
+    auto cross2 = [](glm::vec2 a, glm::vec2 b) { return a.x * b.y - a.y * b.x; };
+    const glm::vec2 scale(info.instanceWidth, info.instanceHeight);
+    glm::vec2 c[3];
+    for (uint32_t k=0; k<3; k++) {
+        c[k] = glm::vec2(triangle[k].pos) * scale;
+    }
+
+    RefineShaded ret{};
+    float area = cross2(c[1] - c[0], c[2] - c[0]);
+    if (std::abs(area) < refineMinArea) {
+        return ret;
+    }
+    ret.orientation = area > 0.0f ? 1.0f : -1.0f;
+
+    glm::vec3 distances;
+    glm::vec3 lengths;
+    for (uint32_t k=0; k<3; k++) {
+        glm::vec2 a = c[(k+1)%3];
+        glm::vec2 u = c[(k+2)%3] - a;
+        lengths[k] = glm::length(u);
+        distances[k] = ret.orientation * cross2(u, p - a) / lengths[k];
+        if (distances[k] < distances[ret.edge]) {
+            ret.edge = k;
+        }
+    }
+    ret.coverage = 1.0f / (1.0f + std::exp(-distances[ret.edge] / info.sigma));
+    if (ret.coverage < refineMinCoverage) {
+        return ret;
+    }
+
+    ret.bary = glm::max(distances * lengths, glm::vec3(0.0f));
+    float sum = ret.bary.x + ret.bary.y + ret.bary.z;
+    ret.bary = sum > 0.0f ? ret.bary / sum : glm::vec3(1.0f / 3.0f);
+    ret.color = ret.bary.x * triangle[0].color + ret.bary.y * triangle[1].color + ret.bary.z * triangle[2].color;
+    ret.hit = true;
+    return ret;
+}
+
+void _edgeGradient(glm::vec2 a, glm::vec2 b, glm::vec2 p, float orientation, glm::vec2& da, glm::vec2& db) {
+    glm::vec2 u = b - a;
+    glm::vec2 q = p - a;
+    float l = glm::length(u);
+    float cr = u.x * q.y - u.y * q.x;
+    da = orientation * (glm::vec2(b.y - p.y, p.x - b.x) / l + cr * u / (l * l * l));
+    db = orientation * (glm::vec2(q.y, -q.x) / l - cr * u / (l * l * l));
+}
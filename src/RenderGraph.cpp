@@ -0,0 +1,133 @@
+#include <RenderGraph.h>
+#include <Profiler.h>
+
+const VkAccessFlags2KHR graphWriteAccess =
+    VK_ACCESS_2_SHADER_WRITE_BIT_KHR |
+    VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT_KHR |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR |
+    VK_ACCESS_2_HOST_WRITE_BIT_KHR |
+    VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+uint64_t _resourceKey(const RenderGraph& graph, const GraphUse& use) {
+    uint64_t key = use.image ? (uint64_t)use.image->image : (uint64_t)use.buffer;
+    auto alias = graph.aliases.find(key);
+    return alias == graph.aliases.end() ? key : alias->second;
+}
+
+void renderGraphImportImage(RenderGraph& graph, const Image& image, VkImageLayout layout) {
+    graph.states[(uint64_t)image.image] = GraphResourceState { .layout = layout };
+}
+
+void renderGraphAlias(RenderGraph& graph, VkBuffer buffer, VkBuffer sharesWith) {
+    auto key = (uint64_t)sharesWith;
+    auto alias = graph.aliases.find(key);
+    graph.aliases[(uint64_t)buffer] = alias == graph.aliases.end() ? key : alias->second;
+}
+
+void renderGraphAddPass(RenderGraph& graph, GraphPass pass) {
+    graph.passes.push_back(std::move(pass));
+}
+
+void renderGraphExecute(Ctx& ctx, RenderGraph& graph) {
+    auto cmdBuffer = ctx.frameCtx.cmdBuffer;
+
+    for (auto& pass : graph.passes) {
+        std::vector<VkBufferMemoryBarrier2KHR> bufferBarriers;
+        std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+
+        for (const auto& use : pass.uses) {
+            assert((use.buffer != VK_NULL_HANDLE) != (use.image != nullptr));
+            auto& state = graph.states[_resourceKey(graph, use)];
+
+            const bool writes = use.access & graphWriteAccess;
+            const bool layoutChange = use.image && use.layout != state.layout;
+            const bool visible = (state.readStages & use.stage) == use.stage && (state.readAccess & use.access) == use.access;
+
+            VkPipelineStageFlags2KHR srcStage = 0;
+            VkAccessFlags2KHR srcAccess = 0;
+            bool needed = false;
+            if (writes || layoutChange) {
+                // Wait for the last write and every read since, reads need no flush
+                srcStage = state.writeStage | state.readStages;
+                srcAccess = state.writeAccess;
+                needed = srcStage != 0 || layoutChange;
+            } else if (state.writeStage && !visible) {
+                srcStage = state.writeStage;
+                srcAccess = state.writeAccess;
+                needed = true;
+            }
+
+            if (needed) {
+                if (use.image) {
+                    imageBarriers.push_back(VkImageMemoryBarrier2KHR {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR,
+                        .srcStageMask = srcStage ? srcStage : VK_PIPELINE_STAGE_2_NONE_KHR,
+                        .srcAccessMask = srcAccess,
+                        .dstStageMask = use.stage,
+                        .dstAccessMask = use.access,
+                        .oldLayout = use.discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+                        .newLayout = use.layout,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .image = use.image->image,
+                        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, use.image->layers },
+                    });
+                } else {
+                    bufferBarriers.push_back(VkBufferMemoryBarrier2KHR {
+                        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR,
+                        .srcStageMask = srcStage,
+                        .srcAccessMask = srcAccess,
+                        .dstStageMask = use.stage,
+                        .dstAccessMask = use.access,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .buffer = use.buffer,
+                        .offset = 0,
+                        .size = VK_WHOLE_SIZE,
+                    });
+                }
+            }
+
+            if (writes) {
+                state.writeStage = use.stage;
+                state.writeAccess = use.access & graphWriteAccess;
+                state.readStages = 0;
+                state.readAccess = 0;
+            } else if (layoutChange) {
+                // The transition is a write finished at this stage, and already visible to this use
+                state.writeStage = use.stage;
+                state.writeAccess = 0;
+                state.readStages = use.stage;
+                state.readAccess = use.access;
+            } else {
+                state.readStages |= use.stage;
+                state.readAccess |= use.access;
+            }
+            if (use.image) {
+                state.layout = use.layout;
+            }
+        }
+
+        if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+            VkDependencyInfoKHR dependencyInfo {
+                .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR,
+                .bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size()),
+                .pBufferMemoryBarriers = bufferBarriers.data(),
+                .imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+                .pImageMemoryBarriers = imageBarriers.data(),
+            };
+            ctx.cmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
+        }
+
+        if (graph.profiler) {
+            profilerBeginScope(ctx, *graph.profiler, pass.name);
+        }
+        pass.record(ctx);
+        if (graph.profiler) {
+            profilerEndScope(ctx, *graph.profiler);
+        }
+    }
+    graph.passes.clear();
+}
@@ -0,0 +1,30 @@
+#include <Shaders.h>
+
+namespace shaders {
+
+VkShaderModule createModule(VkDevice device, const char* name) {
+    auto it = embedded.find(name);
+    if (it == embedded.end()) {
+        logger::crash(fmt::format("Shader {} is not embedded, add it to CMakeLists.txt", name));
+    }
+
+    VkShaderModuleCreateInfo createInfo {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = it->second.size_bytes(),
+        .pCode = it->second.data(),
+    };
+
+    VkShaderModule ret;
+    vkCheck(vkCreateShaderModule(device, &createInfo, nullptr, &ret));
+    return ret;
+}
+
+VkSpecializationInfo specializationInfo(const std::vector<uint32_t>& constants, std::vector<VkSpecializationMapEntry>& entries) {
+    entries.resize(constants.size());
+    for (uint32_t i=0; i<constants.size(); i++) {
+        entries[i] = vks::initializers::specializationMapEntry(i, i * sizeof(uint32_t), sizeof(uint32_t));
+    }
+    return vks::initializers::specializationInfo(entries, constants.size() * sizeof(uint32_t), constants.data());
+}
+
+}
@@ -0,0 +1,76 @@
+#include <Sockets.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+SocketEndpoint socketParseEndpoint(const char* endpoint) {
+    SocketEndpoint ret{};
+    if (std::all_of(endpoint, endpoint + strlen(endpoint), ::isdigit)) {
+        ret.port = std::stoul(endpoint);
+    } else {
+        ret.path = endpoint;
+    }
+    return ret;
+}
+
+int socketListen(const SocketEndpoint& endpoint) {
+    int fd;
+    if (endpoint.path) {
+        sockaddr_un address{ .sun_family = AF_UNIX };
+        if (strlen(endpoint.path) >= sizeof(address.sun_path)) {
+            logger::crash(fmt::format("Socket path {} is too long", endpoint.path));
+        }
+        strcpy(address.sun_path, endpoint.path);
+        unlink(endpoint.path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            logger::crash(fmt::format("Could not bind socket {}: {}", endpoint.path, strerror(errno)));
+        }
+    } else {
+        sockaddr_in address {
+            .sin_family = AF_INET,
+            .sin_port = htons(endpoint.port),
+            .sin_addr = { .s_addr = htonl(INADDR_LOOPBACK) },
+        };
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            logger::crash(fmt::format("Could not bind port {}: {}", endpoint.port, strerror(errno)));
+        }
+    }
+    if (listen(fd, 8) != 0) {
+        logger::crash(fmt::format("Could not listen: {}", strerror(errno)));
+    }
+    return fd;
+}
+
+int socketAccept(int listenSocket, int timeoutMs) {
+    pollfd listener { .fd = listenSocket, .events = POLLIN };
+    if (poll(&listener, 1, timeoutMs) <= 0) {
+        return -1;
+    }
+    return accept(listenSocket, nullptr, nullptr);
+}
+
+bool socketSend(int socket, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t written = send(socket, data.data(), data.size(), MSG_NOSIGNAL);
+        if (written <= 0) {
+            return false;
+        }
+        data.remove_prefix(written);
+    }
+    return true;
+}
+
+void socketClose(int socket, const SocketEndpoint& endpoint) {
+    close(socket);
+    if (endpoint.path) {
+        unlink(endpoint.path);
+    }
+}
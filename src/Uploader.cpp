@@ -0,0 +1,230 @@
+#include <Uploader.h>
+#include <Ctx.h>
+#include <mutex>
+
+// Covers the bufferOffset alignment of buffer to image copies for every format we upload
+constexpr size_t ringAlignment = 16;
+
+// Stage init runs on worker threads, which all upload through the one ring
+std::mutex uploaderMutex;
+
+size_t _ringAlloc(Ctx& ctx, Uploader& uploader, size_t size);
+void _write(Ctx& ctx, Uploader& uploader, size_t ringOffset, const void* data, size_t size);
+VkCommandBuffer _pendingCmdBuffer(Ctx& ctx, Uploader& uploader);
+void _copyImageLayer(VkCommandBuffer cmdBuffer, VkBuffer src, size_t srcOffset, const Image& image, uint32_t layer, VkImageLayout layout);
+uint64_t _flush(Ctx& ctx, Uploader& uploader);
+void _retire(Ctx& ctx, Uploader& uploader, uint64_t waitValue);
+
+Uploader uploaderCreate(Ctx& ctx, size_t ringSize) {
+    assert(ringSize % ringAlignment == 0);
+    Uploader ret{ .ringSize = ringSize };
+
+    auto bufferInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, static_cast<VkDeviceSize>(ringSize));
+    VmaAllocationCreateInfo allocInfo {
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY,
+    };
+    VmaAllocationInfo allocationInfo;
+    vkCheck(vmaCreateBuffer(ctx.allocator, &bufferInfo, &allocInfo, &ret.ring.buffer, &ret.ring.memory, &allocationInfo));
+    ret.mapped = static_cast<uint8_t*>(allocationInfo.pMappedData);
+
+    auto poolInfo = vks::initializers::commandPoolCreateInfo(ctx.queues.transferFamily);
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    vkCheck(vkCreateCommandPool(ctx.device, &poolInfo, nullptr, &ret.commandPool));
+
+    VkSemaphoreTypeCreateInfo typeInfo {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    auto semaphoreInfo = vks::initializers::semaphoreCreateInfo();
+    semaphoreInfo.pNext = &typeInfo;
+    vkCheck(vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &ret.timeline));
+
+    logger::debug("Staging ring of {} MiB on queue family {}", ringSize >> 20, ctx.queues.transferFamily);
+    return ret;
+}
+
+void uploaderDestroy(Ctx& ctx, Uploader& uploader) {
+    uploaderWait(ctx, uploader, uploaderFlush(ctx, uploader));
+    assert(uploader.inFlight.empty());
+    vkDestroySemaphore(ctx.device, uploader.timeline, nullptr);
+    vkDestroyCommandPool(ctx.device, uploader.commandPool, nullptr);
+    vmaDestroyBuffer(ctx.allocator, uploader.ring.buffer, uploader.ring.memory);
+}
+
+void uploaderBuffer(Ctx& ctx, Uploader& uploader, const Buffer& dst, size_t offset, size_t size, const void* data) {
+    std::lock_guard<std::mutex> lock(uploaderMutex);
+    // Large buffers go through the ring in pieces, so a full ring never has to wait on itself
+    const size_t chunk = uploader.ringSize / 2;
+    for (size_t done=0; done<size; done+=chunk) {
+        size_t chunkSize = std::min(chunk, size - done);
+        size_t ringOffset = _ringAlloc(ctx, uploader, chunkSize);
+        _write(ctx, uploader, ringOffset, static_cast<const uint8_t*>(data) + done, chunkSize);
+
+        VkBufferCopy copyRegion {
+            .srcOffset = static_cast<VkDeviceSize>(ringOffset),
+            .dstOffset = static_cast<VkDeviceSize>(offset + done),
+            .size = static_cast<VkDeviceSize>(chunkSize),
+        };
+        vkCmdCopyBuffer(_pendingCmdBuffer(ctx, uploader), uploader.ring.buffer, dst.buffer, 1, &copyRegion);
+    }
+}
+
+void uploaderImageLayer(Ctx& ctx, Uploader& uploader, const Image& image, uint32_t layer, VkImageLayout layout, const void* pixels, size_t size) {
+    assert(layer < image.layers);
+    std::lock_guard<std::mutex> lock(uploaderMutex);
+    size_t ringOffset = _ringAlloc(ctx, uploader, size);
+    _write(ctx, uploader, ringOffset, pixels, size);
+    _copyImageLayer(_pendingCmdBuffer(ctx, uploader), uploader.ring.buffer, ringOffset, image, layer, layout);
+}
+
+uint64_t uploaderCopyImageLayer(Ctx& ctx, Uploader& uploader, const Buffer& src, size_t srcOffset, const Image& image, uint32_t layer, VkImageLayout layout) {
+    assert(layer < image.layers);
+    std::lock_guard<std::mutex> lock(uploaderMutex);
+    _copyImageLayer(_pendingCmdBuffer(ctx, uploader), src.buffer, srcOffset, image, layer, layout);
+    // The pending batch signals the next value once it is flushed
+    return uploader.submittedValue + 1;
+}
+
+void uploaderTransition(Ctx& ctx, Uploader& uploader, const Image& image, VkImageLayout layout) {
+    std::lock_guard<std::mutex> lock(uploaderMutex);
+    auto barrier = vks::initializers::imageMemoryBarrier(image.image, VK_IMAGE_LAYOUT_UNDEFINED, layout);
+    barrier.subresourceRange.layerCount = image.layers;
+    vkCmdPipelineBarrier(_pendingCmdBuffer(ctx, uploader), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+uint64_t uploaderFlush(Ctx& ctx, Uploader& uploader) {
+    std::lock_guard<std::mutex> lock(uploaderMutex);
+    return _flush(ctx, uploader);
+}
+
+bool uploaderDone(Ctx& ctx, Uploader& uploader, uint64_t value) {
+    uint64_t completed;
+    vkCheck(vkGetSemaphoreCounterValue(ctx.device, uploader.timeline, &completed));
+    return completed >= value;
+}
+
+void uploaderWait(Ctx& ctx, Uploader& uploader, uint64_t value) {
+    std::lock_guard<std::mutex> lock(uploaderMutex);
+    _retire(ctx, uploader, value);
+}
+
+// Private implementation
+void _copyImageLayer(VkCommandBuffer cmdBuffer, VkBuffer src, size_t srcOffset, const Image& image, uint32_t layer, VkImageLayout layout) {
+    // Only stages every queue family supports, the timeline semaphore orders the batch against the frame
+    auto toTransfer = vks::initializers::imageMemoryBarrier(image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    toTransfer.subresourceRange.baseArrayLayer = layer;
+    toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy copyRegion = vks::initializers::imageCopy(image.width, image.height);
+    copyRegion.bufferOffset = static_cast<VkDeviceSize>(srcOffset);
+    copyRegion.imageSubresource.baseArrayLayer = layer;
+    vkCmdCopyBufferToImage(cmdBuffer, src, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+    auto toLayout = vks::initializers::imageMemoryBarrier(image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout);
+    toLayout.subresourceRange.baseArrayLayer = layer;
+    toLayout.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &toLayout);
+}
+
+size_t _ringAlloc(Ctx& ctx, Uploader& uploader, size_t size) {
+    if (size > uploader.ringSize) {
+        logger::crash(fmt::format("Upload of {} bytes does not fit in the {} byte staging ring", size, uploader.ringSize));
+    }
+
+    size_t start = (uploader.head + ringAlignment - 1) / ringAlignment * ringAlignment;
+    // Allocations never wrap around the end of the ring
+    if (start % uploader.ringSize + size > uploader.ringSize) {
+        start = (start / uploader.ringSize + 1) * uploader.ringSize;
+    }
+
+    _retire(ctx, uploader, 0);
+    while (start + size - uploader.tail > uploader.ringSize) {
+        if (uploader.inFlight.empty() && uploader.pending == VK_NULL_HANDLE) {
+            // Nothing reads from the ring anymore
+            uploader.tail = start;
+            break;
+        }
+        if (uploader.inFlight.empty()) {
+            // The batch being recorded fills the ring, it has to go out before it can be reused
+            _flush(ctx, uploader);
+        }
+        _retire(ctx, uploader, uploader.inFlight.front().value);
+    }
+
+    uploader.head = start + size;
+    return start % uploader.ringSize;
+}
+
+void _write(Ctx& ctx, Uploader& uploader, size_t ringOffset, const void* data, size_t size) {
+    memcpy(uploader.mapped + ringOffset, data, size);
+    vmaFlushAllocation(ctx.allocator, uploader.ring.memory, ringOffset, size);
+}
+
+VkCommandBuffer _pendingCmdBuffer(Ctx& ctx, Uploader& uploader) {
+    if (uploader.pending != VK_NULL_HANDLE) {
+        return uploader.pending;
+    }
+
+    auto allocInfo = vks::initializers::commandBufferAllocateInfo(uploader.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+    vkCheck(vkAllocateCommandBuffers(ctx.device, &allocInfo, &uploader.pending));
+    auto beginInfo = vks::initializers::commandBufferBeginInfo();
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkCheck(vkBeginCommandBuffer(uploader.pending, &beginInfo));
+    return uploader.pending;
+}
+
+uint64_t _flush(Ctx& ctx, Uploader& uploader) {
+    if (uploader.pending == VK_NULL_HANDLE) {
+        return uploader.submittedValue;
+    }
+    vkCheck(vkEndCommandBuffer(uploader.pending));
+
+    uint64_t value = uploader.submittedValue + 1;
+    VkTimelineSemaphoreSubmitInfo timelineInfo {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &value,
+    };
+    auto submitInfo = vks::initializers::submitInfo(&uploader.pending);
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &uploader.timeline;
+    ctxQueueSubmit(ctx, ctx.queues.transfer, submitInfo, VK_NULL_HANDLE);
+
+    uploader.inFlight.push_back(UploadBatch {
+        .cmdBuffer = uploader.pending,
+        .value = value,
+        .ringEnd = uploader.head,
+    });
+    uploader.pending = VK_NULL_HANDLE;
+    uploader.submittedValue = value;
+    return value;
+}
+
+// Blocks until waitValue is reached, then frees the staging space of every finished batch
+void _retire(Ctx& ctx, Uploader& uploader, uint64_t waitValue) {
+    if (waitValue > 0) {
+        VkSemaphoreWaitInfo waitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+            .semaphoreCount = 1,
+            .pSemaphores = &uploader.timeline,
+            .pValues = &waitValue,
+        };
+        vkCheck(vkWaitSemaphores(ctx.device, &waitInfo, UINT64_MAX));
+    }
+
+    uint64_t completed;
+    vkCheck(vkGetSemaphoreCounterValue(ctx.device, uploader.timeline, &completed));
+    while (!uploader.inFlight.empty() && uploader.inFlight.front().value <= completed) {
+        auto& batch = uploader.inFlight.front();
+        vkFreeCommandBuffers(ctx.device, uploader.commandPool, 1, &batch.cmdBuffer);
+        uploader.tail = batch.ringEnd;
+        uploader.inFlight.pop_front();
+    }
+}
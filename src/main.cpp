@@ -1,4 +1,7 @@
 #include <precomp.h>
+#include <future>
+#include <numeric>
+#include <random>
 #include <Ctx.h>
 #include <RenderPass.h>
 #include <Rast.h>
@@ -6,26 +9,110 @@
 #include <BufferTools.h>
 #include <GridRender.h>
 #include <QuadRender.h>
+#include <Presenter.h>
 #include <Evolve.h>
 #include <Lottery.h>
 #include <Grader.h>
+#include <Batch.h>
+#include <Dedup.h>
+#include <Refine.h>
+#include <Climb.h>
+#include <Plateau.h>
+#include <Profiler.h>
+#include <Overdraw.h>
+#include <Cull.h>
+#include <Metrics.h>
+#include <Control.h>
+#include <RenderGraph.h>
 
 constexpr uint32_t g_imageWidth = 256;
 constexpr uint32_t g_imageHeight = 320;
 constexpr uint32_t g_trianglesPerInstance = 100;
 constexpr uint32_t g_instancesWidth = 6;
 constexpr uint32_t g_instancesHeight = 6;
-constexpr uint32_t g_totalInstances = g_instancesWidth * g_instancesHeight;
-constexpr uint32_t g_totalTriangles = g_totalInstances * g_trianglesPerInstance;
+constexpr uint32_t g_instancesPerLayer = g_instancesWidth * g_instancesHeight;
 constexpr uint32_t g_windowWidth = g_imageWidth * g_instancesWidth;
 constexpr uint32_t g_windowHeight = g_imageHeight * g_instancesHeight;
+// Number of goal images evolved side by side in batch mode
+constexpr uint32_t g_batchSlots = 4;
+static_assert(g_instancesPerLayer % g_batchSlots == 0);
+
+const char* g_batchManifest = nullptr;
+uint32_t g_nrGoals = 1;
+// A fixed seed makes the whole run reproducible, see --seed
+uint32_t g_runSeed = 0;
+bool g_deterministic = false;
+// Layers of the grid image, each holds another g_instancesPerLayer instances
+uint32_t g_gridLayers = 1;
+uint32_t g_totalInstances = g_instancesPerLayer;
+uint32_t g_totalTriangles = g_totalInstances * g_trianglesPerInstance;
+// Snapshots are shown from a separate thread, evolution is not tied to the display, see --present-thread
+bool g_presentThread = false;
+// Grade a per generation subset of the rows, denser as fitness converges, see --stochastic
+bool g_stochastic = false;
+// Genomes start with this many active triangles and grow up to g_trianglesPerInstance, see --grow
+bool g_grow = false;
+uint32_t g_startTriangles = g_trianglesPerInstance;
+// Chance per child to gain or lose a triangle
+constexpr float g_growRate = 0.01f;
+constexpr float g_shrinkRate = 0.005f;
+// Children identical to a parent inherit its score instead of being rendered and graded, see --dedup
+bool g_dedup = false;
+// Both of the above draw every instance through its own indirect draw
+bool g_indirectDraws = false;
+// Every this many generations the champions take gradient steps, 0 never, see --refine
+uint32_t g_refineInterval = 0;
+constexpr uint32_t g_refineSteps = 10;
+// Candidates per instance and generation of the hill climb that replaces the GA, 0 keeps the GA, see --climb
+uint32_t g_climbCandidates = 0;
+// Start temperature of simulated annealing, 0 only takes improvements, see --anneal
+float g_climbTemperature = 0.0f;
+constexpr float g_climbCooling = 0.999f;
+// Every instance carries its own mutation rate and step, see --adaptive
+bool g_adaptive = false;
+// Stops a goal once it reaches the target fitness, stalls for a window of generations or runs out of them,
+// always on in batch mode, see --plateau, --target and --max-generations
+bool g_plateau = false;
+float g_targetFitness = 0.9f;
+uint32_t g_plateauWindow = 1000;
+uint32_t g_maxGenerations = 100000;
+// Wall clock limit of the whole run in seconds, 0 for none, see --budget
+double g_timeBudget = 0.0;
+// Every this many generations the passes are measured with pipeline statistics and the
+// overdraw of the genomes is counted, 0 never, see --profile
+uint32_t g_profileInterval = 0;
+// Triangles that cannot change the image are dropped before the grid render, see --cull
+bool g_cull = false;
+// Prometheus metrics on this localhost port or unix socket, see --metrics
+std::optional<MetricsInfo> g_metrics;
+// Parameters, goal images and pausing retuned at runtime over this localhost port or unix socket, see --control
+std::optional<SocketEndpoint> g_control;
+// Format the batch keeps its goal images in and how many it decodes ahead, see --goal-bits and --prefetch
+VkFormat g_goalFormat = VK_FORMAT_R32G32B32A32_SFLOAT;
+uint32_t g_prefetch = 8;
+// Vertices in the pool every instance indexes its triangles from, 0 for three own vertices per triangle, see --mesh
+uint32_t g_meshVertices = 0;
 
 Ctx ctx;
 struct {
     Image gridTarget;
     Buffer vertexBuffers[2];
+    // Active triangles per instance as indirect draws, only with --grow
+    Buffer drawBuffers[2];
+    // Per instance the parent it duplicates, only with --dedup
+    Buffer duplicates;
+    // Per instance EvolveStrategy, only with --adaptive
+    Buffer strategyBuffers[2];
+    // Three indices into the vertex pool of the instance per triangle, only with --mesh
+    Buffer indexBuffers[2];
+    // The triangles the grid render draws and a draw per instance, only with --cull
+    Buffer culledVertices;
+    Buffer culledDraws;
     Buffer scoresBuffer;
     Buffer parentsBuffer;
+    Buffer tilePartials;
+    // parentsBuffer and tilePartials, sharing one allocation
+    std::vector<Buffer> transientBuffers;
     Image goal;
 } resources;
 
@@ -36,97 +123,456 @@ void initResources();
 Evolve initEvolve();
 GridRender initGridRender();
 QuadRender initQuadRender();
+Presenter initPresenter();
 Lottery initLottery();
 Grader initGrader();
+Batch initBatch(Plateau& plateau);
+Dedup initDedup();
+Refine initRefine();
+Climb initClimb();
+Plateau initPlateau();
+Overdraw initOverdraw();
+Cull initCull();
+Control initControl();
+void applyControl(Ctx& ctx, std::vector<ControlCommand>& commands, LotteryArgs& lotteryArgs, EvolveArgs& evolveArgs,
+        Plateau* plateau, bool& paused, bool& regrade);
+void logProfile(Ctx& ctx, const std::vector<ProfilerScope>& scopes, Overdraw& overdraw);
 
 
 int main(int argc, char** argv) {
     logger::set_level(spdlog::level::trace);
 
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "--batch") == 0 && i+1 < argc) {
+            g_batchManifest = argv[++i];
+            g_nrGoals = g_batchSlots;
+        } else if (strcmp(argv[i], "--seed") == 0 && i+1 < argc) {
+            g_runSeed = std::stoul(argv[++i]);
+            g_deterministic = true;
+        } else if (strcmp(argv[i], "--layers") == 0 && i+1 < argc) {
+            g_gridLayers = std::max(1ul, std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--present-thread") == 0) {
+            g_presentThread = true;
+        } else if (strcmp(argv[i], "--stochastic") == 0) {
+            g_stochastic = true;
+        } else if (strcmp(argv[i], "--grow") == 0 && i+1 < argc) {
+            g_grow = true;
+            g_startTriangles = std::clamp(std::stoul(argv[++i]), 1ul, static_cast<unsigned long>(g_trianglesPerInstance));
+        } else if (strcmp(argv[i], "--dedup") == 0) {
+            g_dedup = true;
+        } else if (strcmp(argv[i], "--refine") == 0 && i+1 < argc) {
+            g_refineInterval = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--climb") == 0 && i+1 < argc) {
+            g_climbCandidates = std::max(1ul, std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--anneal") == 0 && i+1 < argc) {
+            g_climbTemperature = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--adaptive") == 0) {
+            g_adaptive = true;
+        } else if (strcmp(argv[i], "--plateau") == 0 && i+1 < argc) {
+            g_plateau = true;
+            g_plateauWindow = std::max(1ul, std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--target") == 0 && i+1 < argc) {
+            g_plateau = true;
+            g_targetFitness = std::stof(argv[++i]);
+        } else if (strcmp(argv[i], "--max-generations") == 0 && i+1 < argc) {
+            g_plateau = true;
+            g_maxGenerations = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--budget") == 0 && i+1 < argc) {
+            g_timeBudget = std::stod(argv[++i]);
+        } else if (strcmp(argv[i], "--profile") == 0 && i+1 < argc) {
+            g_profileInterval = std::stoul(argv[++i]);
+        } else if (strcmp(argv[i], "--cull") == 0) {
+            g_cull = true;
+        } else if (strcmp(argv[i], "--metrics") == 0 && i+1 < argc) {
+            g_metrics = MetricsInfo{ .endpoint = socketParseEndpoint(argv[++i]) };
+        } else if (strcmp(argv[i], "--control") == 0 && i+1 < argc) {
+            g_control = socketParseEndpoint(argv[++i]);
+        } else if (strcmp(argv[i], "--goal-bits") == 0 && i+1 < argc) {
+            const uint32_t bits = std::stoul(argv[++i]);
+            if (bits == 8) {
+                g_goalFormat = VK_FORMAT_R8G8B8A8_UNORM;
+            } else if (bits == 16) {
+                g_goalFormat = VK_FORMAT_R16G16B16A16_UNORM;
+            } else if (bits != 32) {
+                logger::crash("--goal-bits takes 8, 16 or 32");
+            }
+        } else if (strcmp(argv[i], "--prefetch") == 0 && i+1 < argc) {
+            g_prefetch = std::max(1ul, std::stoul(argv[++i]));
+        } else if (strcmp(argv[i], "--mesh") == 0 && i+1 < argc) {
+            g_meshVertices = std::max(3ul, std::stoul(argv[++i]));
+        } else {
+            logger::crash(fmt::format("usage: {} [--batch manifest.txt] [--seed N] [--layers N] [--present-thread] [--stochastic] [--grow N] [--dedup] [--refine N] [--climb N] [--anneal T] [--adaptive] [--plateau N] [--target F] [--max-generations N] [--budget S] [--profile N] [--cull] [--metrics port|socket] [--control port|socket] [--goal-bits 8|16|32] [--prefetch N] [--mesh N]", argv[0]));
+        }
+    }
+    if (g_climbCandidates > 0 && (g_batchManifest || g_grow || g_dedup || g_stochastic || g_refineInterval > 0)) {
+        logger::crash("--climb keeps its own scores of fixed length genomes, it does not go with --batch, --grow, --dedup, --stochastic or --refine");
+    }
+    if (g_meshVertices > 0 && (g_batchManifest || g_grow || g_dedup || g_adaptive || g_climbCandidates > 0
+            || g_refineInterval > 0 || g_cull || g_profileInterval > 0)) {
+        logger::crash("--mesh genomes only evolve with the GA, they do not go with --batch, --grow, --dedup, --adaptive, --climb, --refine, --cull or --profile");
+    }
+    if (g_goalFormat != VK_FORMAT_R32G32B32A32_SFLOAT && !g_batchManifest) {
+        logger::crash("--goal-bits only applies to the goals of --batch");
+    }
+    g_indirectDraws = g_grow || g_dedup;
+    g_plateau = g_plateau || g_batchManifest;
+    g_totalInstances = g_instancesPerLayer * g_gridLayers;
+    g_totalTriangles = g_totalInstances * g_trianglesPerInstance;
+    if (!g_deterministic) {
+        g_runSeed = std::random_device{}();
+    }
+    logger::info("Run seed: {}{}", g_runSeed, g_deterministic ? " (deterministic)" : "");
+    logger::info("Population: {} instances on {} grid layers", g_totalInstances, g_gridLayers);
+    if (g_grow) {
+        logger::info("Genomes grow from {} up to {} triangles", g_startTriangles, g_trianglesPerInstance);
+    }
+    if (g_meshVertices > 0) {
+        logger::info("Genomes index their triangles into a pool of {} vertices", g_meshVertices);
+    }
+    if (g_refineInterval > 0) {
+        logger::info("Champions take {} gradient steps every {} generations", g_refineSteps, g_refineInterval);
+    }
+    if (g_plateau) {
+        logger::info("Goals stop at fitness {}, after {} generations or when {} generations in a row gain too little",
+                g_targetFitness, g_maxGenerations, g_plateauWindow);
+    }
+    if (g_climbCandidates > 0) {
+        logger::info("Every instance climbs with {} candidates per generation, temperature {}", g_climbCandidates, g_climbTemperature);
+    }
+
     ctx = mkCtx();
     printSubgroupInfo(ctx);
 
     initResources();
 
-    auto evolve = initEvolve();
-    auto lottery = initLottery();
-    auto gridRender = initGridRender();
-    auto quadRender = initQuadRender();
-    auto grader = initGrader();
-
+    // Pipeline compilation dominates startup, so the stages are built on worker threads
+    auto evolveTask = std::async(std::launch::async, initEvolve);
+    auto lotteryTask = std::async(std::launch::async, initLottery);
+    auto gridRenderTask = std::async(std::launch::async, initGridRender);
+    std::future<QuadRender> quadRenderTask;
+    std::future<Presenter> presenterTask;
+    if (g_presentThread) {
+        presenterTask = std::async(std::launch::async, initPresenter);
+    } else {
+        quadRenderTask = std::async(std::launch::async, initQuadRender);
+    }
+    auto graderTask = std::async(std::launch::async, initGrader);
+    auto evolve = evolveTask.get();
+    auto lottery = lotteryTask.get();
+    auto gridRender = gridRenderTask.get();
+    std::optional<QuadRender> quadRender;
+    std::optional<Presenter> presenter;
+    if (g_presentThread) {
+        presenter = presenterTask.get();
+    } else {
+        quadRender = quadRenderTask.get();
+    }
+    auto grader = graderTask.get();
+    // The metrics follow the fitness without stopping anything
+    std::optional<Plateau> plateau;
+    if (g_plateau || g_metrics) {
+        plateau = initPlateau();
+    }
+    // The metrics time the passes of every generation
+    std::optional<Profiler> profiler;
+    if (g_profileInterval > 0 || g_metrics) {
+        ProfilerInfo profilerInfo {
+            .statistics = g_profileInterval > 0,
+        };
+        profiler = profilerCreate(ctx, profilerInfo);
+    }
+    std::optional<Overdraw> overdraw;
+    if (g_profileInterval > 0) {
+        overdraw = initOverdraw();
+    }
+    std::optional<Metrics> metrics;
+    if (g_metrics) {
+        metrics = metricsCreate(*g_metrics);
+        metricsMemory(*metrics, ctx);
+    }
+    std::optional<Cull> cull;
+    if (g_cull) {
+        cull = initCull();
+    }
+    std::optional<Batch> batch;
+    if (g_batchManifest) {
+        batch = initBatch(*plateau);
+    }
+    std::optional<Dedup> dedup;
+    if (g_dedup) {
+        dedup = initDedup();
+    }
+    std::optional<Refine> refine;
+    if (g_refineInterval > 0) {
+        refine = initRefine();
+    }
+    std::optional<Climb> climb;
+    if (g_climbCandidates > 0) {
+        climb = initClimb();
+    }
+    std::optional<Control> control;
+    if (g_control) {
+        control = initControl();
+    }
 
-    GridRenderArgs gridArgs {
-        .nrTriangles = g_totalTriangles,
-        .nrInstanceWidth = g_instancesWidth,
-        .nrInstancesHeight = g_instancesHeight,
-    };
+    // Barriers and layout transitions between the stages come from the graph
+    RenderGraph graph;
+    renderGraphImportImage(graph, resources.gridTarget, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    renderGraphImportImage(graph, resources.goal, VK_IMAGE_LAYOUT_GENERAL);
+    renderGraphAlias(graph, resources.tilePartials.buffer, resources.parentsBuffer.buffer);
+    if (presenter) {
+        renderGraphImportImage(graph, presenter->snapshot, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    ctxLogMemoryReport(ctx);
 
-    EvolveArgs evolveArgs{
-        .nrVertices = 3 * g_totalTriangles,
-        .nrTrianglesPerInstance = g_trianglesPerInstance,
+    EvolveArgs evolveArgs {
+        .runSeed = g_runSeed,
     };
-
+    if (g_grow) {
+        evolveArgs.growRate = g_growRate;
+        evolveArgs.shrinkRate = g_shrinkRate;
+    }
     LotteryArgs lotteryArgs {
-        .nrInstances = g_totalInstances,
-        .instanceWidth = g_imageWidth,
-        .instanceHeight = g_imageHeight,
-        .seed = 0,
+        .runSeed = g_runSeed,
     };
-
     GraderArgs graderArgs {
-        .nrInstancesWidth = g_instancesWidth,
-        .nrInstancesHeight = g_instancesHeight,
-        .instanceWidth = g_imageWidth,
-        .instanceHeight = g_imageHeight,
+        .runSeed = g_runSeed,
+    };
+    ClimbArgs climbArgs {
+        .runSeed = g_runSeed,
     };
 
     double ping;
+    const double start = glfwGetTime();
     uint32_t frameCounter = 0;
-    while (!ctxWindowShouldClose(ctx)) {
+    // Set over the control channel
+    bool paused = false;
+    bool regrade = false;
+    // Set by a frame that found the run done, it is still submitted and the loop ends before the next one
+    bool stop = false;
+    while (!stop && !ctxWindowShouldClose(ctx)) {
         ping = glfwGetTime();
+        if (g_timeBudget > 0.0 && ping - start >= g_timeBudget) {
+            logger::info("Time budget of {}s used up", g_timeBudget);
+            break;
+        }
 
         auto frame = ctxBeginFrame(ctx);
+        const double frameWait = glfwGetTime() - ping;
+        // The previous frame is done, the batch, the metrics and the stop check share its states
+        std::vector<PlateauState> states;
+        if (plateau) {
+            states = plateauPoll(ctx, *plateau);
+        }
+        if (batch && !batchUpdate(ctx, *batch, states)) {
+            logger::info("Batch finished");
+            stop = true;
+        }
+        if (control) {
+            // Nothing is in flight while paused, the frame just begins once resumed
+            auto commands = controlPoll(ctx, *control);
+            applyControl(ctx, commands, lotteryArgs, evolveArgs, plateau ? &*plateau : nullptr, paused, regrade);
+            while (paused && !ctxWindowShouldClose(ctx)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                if (!ctx.info.headless) {
+                    glfwPollEvents();
+                }
+                commands = controlPoll(ctx, *control);
+                applyControl(ctx, commands, lotteryArgs, evolveArgs, plateau ? &*plateau : nullptr, paused, regrade);
+            }
+        }
+        if (metrics) {
+            for (uint32_t goal=0; goal<states.size(); goal++) {
+                metricsFitness(*metrics, goal, plateauFitness(*plateau, states[goal].best), plateauFitness(*plateau, states[goal].mean));
+            }
+        }
+        if (g_plateau && !batch) {
+            bool done = std::all_of(states.begin(), states.end(), [](const PlateauState& state) {
+                return state.status != PLATEAU_RUNNING;
+            });
+            if (done) {
+                for (uint32_t goal=0; goal<states.size(); goal++) {
+                    logger::info("Goal {} {}: fitness {} after {} generations", goal, plateauStatusName(states[goal].status),
+                            plateauFitness(*plateau, states[goal].best), states[goal].generations);
+                }
+                stop = true;
+            }
+        }
+        if (dedup && frameCounter % 1000 == 0 && frameCounter > 0) {
+            logger::info("Duplicates skipped: {:.1f}%", 100.0f * dedupRatio(ctx, *dedup));
+        }
+
+        // The frame after a profiled one reads its results
+        const bool logging = overdraw && frame.frameIdx % g_profileInterval == 0;
+        if (profiler) {
+            auto scopes = profilerResults(ctx, *profiler);
+            if (metrics) {
+                metricsStages(*metrics, scopes);
+            }
+            if (overdraw && frame.frameIdx > 0 && (frame.frameIdx - 1) % g_profileInterval == 0) {
+                logProfile(ctx, scopes, *overdraw);
+            }
+        }
 
         auto beginInfo = vks::initializers::commandBufferBeginInfo();
         vkCheck(vkBeginCommandBuffer(frame.cmdBuffer, &beginInfo));
 
+        graph.profiler = nullptr;
+        if (logging || metrics) {
+            profilerBeginFrame(ctx, *profiler);
+            graph.profiler = &*profiler;
+        }
 
-        grindRenderRecord(ctx, gridRender, gridArgs);
+        if (control) {
+            controlAddPasses(ctx, graph, *control);
+        }
+        if (cull) {
+            cullAddPass(ctx, graph, *cull);
+        }
+        gridRenderAddPass(ctx, graph, gridRender);
+        if (logging) {
+            overdrawAddPasses(ctx, graph, *overdraw);
+        }
 
-        graderRecord(ctx, grader, graderArgs);
+        // The climb grades in full only once, it keeps its scores up to date itself until the goal changes
+        if (!climb || frame.frameIdx == 0 || regrade) {
+            // The climb never resets its scores, they would otherwise hold two grades
+            if (climb && regrade) {
+                graderAddResetPass(ctx, graph, grader);
+            }
+            regrade = false;
+            graderArgs.generation = frame.frameIdx;
+            if (g_stochastic) {
+                uint32_t stride = graderScheduleStride(grader.info, graderBestFitness(ctx, grader));
+                if (stride != graderArgs.sampleStride) {
+                    logger::info("Grading 1 in {} rows", stride);
+                }
+                graderArgs.sampleStride = stride;
+            }
+            graderAddPass(ctx, graph, grader, graderArgs);
+        }
+        if (dedup) {
+            dedupAddScorePass(ctx, graph, *dedup);
+        }
+        if (plateau) {
+            plateauAddPasses(ctx, graph, *plateau);
+        }
+        if (refine && frame.frameIdx % g_refineInterval == g_refineInterval - 1) {
+            refineAddPasses(ctx, graph, *refine);
+        }
 
-        lotteryArgs.seed = rand_xorshift(7*frame.frameIdx),
-        lotteryRecord(ctx, lottery, lotteryArgs);
+        if (climb) {
+            climbArgs.generation = frame.frameIdx;
+            climbArgs.temperature = g_climbTemperature * std::pow(g_climbCooling, static_cast<float>(frame.frameIdx));
+            climbAddPass(ctx, graph, *climb, climbArgs);
+        } else {
+            lotteryArgs.generation = frame.frameIdx;
+            lotteryAddPass(ctx, graph, lottery, lotteryArgs);
 
-        evolveArgs.seed = rand_xorshift(lotteryArgs.seed);
-        evolveRecord(ctx, evolve, evolveArgs);
+            evolveArgs.generation = frame.frameIdx;
+            evolveAddPass(ctx, graph, evolve, evolveArgs);
+        }
+        if (dedup) {
+            dedupAddPass(ctx, graph, *dedup);
+        }
 
-        quadRenderRecord(ctx, quadRender);
+        if (presenter) {
+            presenterAddPasses(ctx, graph, *presenter);
+        } else {
+            quadRenderAddPass(ctx, graph, *quadRender);
+        }
+        renderGraphExecute(ctx, graph);
 
         vkCheck(vkEndCommandBuffer(frame.cmdBuffer));
+        const double submit = glfwGetTime();
         ctxEndFrame(ctx, frame.cmdBuffer);
+        if (metrics) {
+            metricsFrame(*metrics, frameWait, glfwGetTime() - submit);
+            if (frameCounter % 100 == 0) {
+                metricsMemory(*metrics, ctx);
+            }
+        }
 
         if (frameCounter % 1000 == 0) {
             double fps = 1.0f / (glfwGetTime() - ping);
             logger::info("FPS: {}", fps);
         }
+        if (frameCounter % 10000 == 0) {
+            ctxLogMemoryReport(ctx);
+        }
         
         frameCounter++;
     }
 
+    if (presenter) {
+        presenterStop(ctx, *presenter);
+    }
+    if (metrics) {
+        metricsDestroy(*metrics);
+    }
     ctxFinish(ctx);
+    if (control) {
+        controlDestroy(ctx, *control);
+    }
+    if (batch) {
+        batchDestroy(ctx, *batch);
+    }
+    if (plateau) {
+        plateauDestroy(ctx, *plateau);
+    }
+    if (profiler) {
+        profilerDestroy(ctx, *profiler);
+    }
+    if (overdraw) {
+        overdrawDestroy(ctx, *overdraw);
+    }
+    if (cull) {
+        cullDestroy(ctx, *cull);
+        buffertools::destroyBuffer(ctx, resources.culledVertices);
+        buffertools::destroyBuffer(ctx, resources.culledDraws);
+    }
+    if (dedup) {
+        dedupDestroy(ctx, *dedup);
+        buffertools::destroyBuffer(ctx, resources.duplicates);
+    }
+    if (refine) {
+        refineDestroy(ctx, *refine);
+    }
+    if (climb) {
+        climbDestroy(ctx, *climb);
+    }
     for (auto& buffer : resources.vertexBuffers) {
         buffertools::destroyBuffer(ctx, buffer);
     }
+    if (g_indirectDraws) {
+        for (auto& buffer : resources.drawBuffers) {
+            buffertools::destroyBuffer(ctx, buffer);
+        }
+    }
+    if (g_adaptive) {
+        for (auto& buffer : resources.strategyBuffers) {
+            buffertools::destroyBuffer(ctx, buffer);
+        }
+    }
+    if (g_meshVertices > 0) {
+        for (auto& buffer : resources.indexBuffers) {
+            buffertools::destroyBuffer(ctx, buffer);
+        }
+    }
     buffertools::destroyBuffer(ctx, resources.scoresBuffer);
-    buffertools::destroyBuffer(ctx, resources.parentsBuffer);
+    buffertools::destroyAliasedBuffers(ctx, resources.transientBuffers);
 
     destroyImage(ctx, resources.gridTarget);
+    destroyImage(ctx, resources.goal);
     graderDestroy(ctx, grader);
     evolveDestroy(ctx, evolve);
     lotteryDestroy(ctx, lottery);
     gridRenderDestroy(ctx, gridRender);
-    quadRenderDestroy(ctx, quadRender);
+    if (presenter) {
+        presenterDestroy(ctx, *presenter);
+    } else {
+        quadRenderDestroy(ctx, *quadRender);
+    }
     ctxDestroy(ctx);
     return 0;
 }
@@ -137,6 +583,10 @@ Ctx mkCtx() {
         .windowHeight = g_windowHeight,
         .instanceExtensions = {},
         .deviceExtensions = {VK_EXT_SHADER_ATOMIC_FLOAT_EXTENSION_NAME},
+        .detachedPresent = g_presentThread,
+        // The presenter must not tear or block, the fused loop only must not block
+        .presentMode = g_presentThread ? VK_PRESENT_MODE_MAILBOX_KHR : VK_PRESENT_MODE_IMMEDIATE_KHR,
+        .storageImageReadWithoutFormat = g_goalFormat != VK_FORMAT_R32G32B32A32_SFLOAT,
     };
 
     return ctxCreate(info);
@@ -156,42 +606,93 @@ void printSubgroupInfo(const Ctx& ctx) {
 }
 
 void initResources() {
-    resources.gridTarget = createImageD(
-            ctx, ctx.window.width, ctx.window.height,
-            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+    resources.gridTarget = createImageArrayD(
+            ctx, ctx.window.width, ctx.window.height, g_gridLayers,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
             VK_FORMAT_R32G32B32A32_SFLOAT,
             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-    // Double buffered vertex buffers
-    std::vector<Vertex> vertexData(3 * g_totalTriangles);
+    // Double buffered vertex buffers, with --mesh they hold the pools
+    std::vector<Vertex> vertexData = g_meshVertices > 0
+        ? randomMeshVertices(g_runSeed, 0, 0, g_totalInstances, g_meshVertices)
+        : randomGenomes(g_runSeed, 0, 0, g_totalInstances, g_trianglesPerInstance);
+    resources.vertexBuffers[0] = buffertools::createBufferD_Data(ctx,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        vertexData.size() * sizeof(Vertex), vertexData.data());
+
+    vertexData.assign(vertexData.size(), Vertex{});
     resources.vertexBuffers[1] = buffertools::createBufferD_Data(ctx,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         vertexData.size() * sizeof(Vertex), vertexData.data());
 
-    for(auto i=0; i<vertexData.size(); i++) {
-        vertexData[i] = Vertex {
-            { randf(), randf(), 0, 0 },
-            { randf(1.0f), randf(1.0f), randf(1.0f), 0.1f, }
-        };
+    if (g_meshVertices > 0) {
+        auto indexData = randomMeshIndices(g_runSeed, 0, 0, g_totalInstances, g_meshVertices, g_trianglesPerInstance);
+        for (auto& buffer : resources.indexBuffers) {
+            buffer = buffertools::createBufferD_Data(ctx,
+                VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                indexData.size() * sizeof(uint32_t), indexData.data());
+        }
+    }
+
+    if (g_indirectDraws) {
+        // Every slot is filled already, the draws decide how many are active
+        auto drawData = genomeDraws(0, g_totalInstances, g_startTriangles);
+        for (auto& buffer : resources.drawBuffers) {
+            buffer = buffertools::createBufferD_Data(ctx,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                drawData.size() * sizeof(VkDrawIndirectCommand), drawData.data());
+        }
+    }
+
+    if (g_cull) {
+        // written by the cull before every grid render
+        resources.culledVertices = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                3 * g_totalTriangles * sizeof(Vertex));
+        resources.culledDraws = buffertools::createBufferD(ctx, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                g_totalInstances * sizeof(VkDrawIndirectCommand));
     }
-    resources.vertexBuffers[0] = buffertools::createBufferD_Data(ctx,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        vertexData.size() * sizeof(Vertex), vertexData.data());
 
+    if (g_adaptive) {
+        std::vector<EvolveStrategy> strategies(g_totalInstances);
+        for (auto& buffer : resources.strategyBuffers) {
+            buffer = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                strategies.size() * sizeof(EvolveStrategy), strategies.data());
+        }
+    }
+
+    if (g_dedup) {
+        std::vector<uint32_t> duplicates(g_totalInstances, dedupNoDuplicate);
+        resources.duplicates = buffertools::createBufferD_Data(ctx, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            duplicates.size() * sizeof(uint32_t), duplicates.data());
+    }
 
-    // last element is used as the total
-    std::vector<float> scores(g_totalInstances+2, 1.0f);
-    std::vector<uint32_t> parents(g_totalInstances*2, 0);
-    scores[g_totalInstances] = 0;
+    std::vector<float> scores(g_totalInstances, 1.0f);
     resources.scoresBuffer = buffertools::createBufferD_Data(ctx,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         scores.size() * sizeof(uint32_t), scores.data());
 
-    resources.parentsBuffer = buffertools::createBufferD_Data(ctx,
-        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        parents.size() * sizeof(uint32_t), parents.data());
-
-    resources.goal = loadImageD(ctx, VK_IMAGE_LAYOUT_GENERAL, "monalisa.bmp");
+    // The tile partials only live while grading, the parents from the lottery until evolve
+    resources.transientBuffers = buffertools::createAliasedBuffersD(ctx, {
+        { VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, g_totalInstances * 2 * sizeof(uint32_t) },
+        { VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, graderTilePartialsSize(resources.gridTarget) },
+    });
+    resources.parentsBuffer = resources.transientBuffers[0];
+    resources.tilePartials = resources.transientBuffers[1];
+
+    if (g_batchManifest) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(ctx.physicalDevice, g_goalFormat, &formatProperties);
+        if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) {
+            logger::crash("The device cannot read goal images of this format as storage images");
+        }
+        // layers are filled in by the batch as jobs get assigned
+        resources.goal = createImageArrayD(ctx, g_imageWidth, g_imageHeight, g_nrGoals,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+            g_goalFormat,
+            VK_IMAGE_LAYOUT_GENERAL);
+    } else {
+        resources.goal = loadImageArrayD(ctx, VK_IMAGE_LAYOUT_GENERAL, {"monalisa.bmp"});
+    }
 
     logger::info("Image dimensions: {}x{}", resources.goal.width, resources.goal.height);
     assert(resources.goal.width == g_imageWidth);
@@ -203,7 +704,23 @@ Evolve initEvolve() {
     EvolveInfo evolveInfo {
         .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
         .parentBuffer = &resources.parentsBuffer,
+        .nrVertices = 3 * g_totalTriangles,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
     };
+    if (g_indirectDraws) {
+        evolveInfo.drawBuffers[0] = &resources.drawBuffers[0];
+        evolveInfo.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+    if (g_meshVertices > 0) {
+        evolveInfo.nrVertices = g_totalInstances * g_meshVertices;
+        evolveInfo.indexBuffers[0] = &resources.indexBuffers[0];
+        evolveInfo.indexBuffers[1] = &resources.indexBuffers[1];
+        evolveInfo.meshVertices = g_meshVertices;
+    }
+    if (g_adaptive) {
+        evolveInfo.strategyBuffers[0] = &resources.strategyBuffers[0];
+        evolveInfo.strategyBuffers[1] = &resources.strategyBuffers[1];
+    }
     return evolveCreate(ctx, evolveInfo);
 }
 
@@ -211,7 +728,25 @@ GridRender initGridRender() {
     GridRenderInfo gridRenderInfo {
         .buffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
         .target = resources.gridTarget,
+        .nrTriangles = g_totalTriangles,
+        .nrInstancesWidth = g_instancesWidth,
+        .nrInstancesHeight = g_instancesHeight,
+        .instanced = true,
     };
+    if (g_indirectDraws) {
+        gridRenderInfo.drawBuffers[0] = &resources.drawBuffers[0];
+        gridRenderInfo.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+    if (g_meshVertices > 0) {
+        gridRenderInfo.indexBuffers[0] = &resources.indexBuffers[0];
+        gridRenderInfo.indexBuffers[1] = &resources.indexBuffers[1];
+        gridRenderInfo.meshVertices = g_meshVertices;
+    }
+    if (g_cull) {
+        // the cull compacts either vertex buffer into the same one
+        gridRenderInfo.buffers[0] = gridRenderInfo.buffers[1] = &resources.culledVertices;
+        gridRenderInfo.drawBuffers[0] = gridRenderInfo.drawBuffers[1] = &resources.culledDraws;
+    }
 
     return gridRenderCreate(ctx, gridRenderInfo);
 }
@@ -224,10 +759,20 @@ QuadRender initQuadRender() {
     return quadRenderCreate(ctx, quadRenderInfo);
 }
 
+Presenter initPresenter() {
+    PresenterInfo presenterInfo {
+        .source = &resources.gridTarget,
+    };
+    return presenterCreate(ctx, presenterInfo);
+}
+
 Lottery initLottery() {
     LotteryInfo info {
         .scoreBuffer = &resources.scoresBuffer,
         .parentBuffer = &resources.parentsBuffer,
+        .nrInstances = g_totalInstances,
+        // a group never spans two goals and fits in one workgroup
+        .nrInstancesPerGroup = std::gcd(g_totalInstances / g_nrGoals, g_instancesPerLayer),
     };
 
     return lotteryCreate(ctx, info);
@@ -238,7 +783,238 @@ Grader initGrader() {
         .gridImage = &resources.gridTarget,
         .goal = &resources.goal,
         .scoreBuffer = &resources.scoresBuffer,
+        .nrInstancesWidth = g_instancesWidth,
+        .nrInstancesHeight = g_instancesHeight,
+        .instanceWidth = g_imageWidth,
+        .instanceHeight = g_imageHeight,
+        .nrInstancesPerGoal = g_totalInstances / g_nrGoals,
+        .deterministic = g_deterministic,
+        .tilePartials = &resources.tilePartials,
+        .stochastic = g_stochastic,
+        .duplicates = g_dedup ? &resources.duplicates : nullptr,
     };
 
     return graderCreate(ctx, info);
 }
+
+Batch initBatch(Plateau& plateau) {
+    BatchInfo info {
+        .manifestPath = g_batchManifest,
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .scoreBuffer = &resources.scoresBuffer,
+        .goals = &resources.goal,
+        .plateau = &plateau,
+        .nrSlots = g_batchSlots,
+        .nrInstancesPerSlot = g_totalInstances / g_batchSlots,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+        .startTriangles = g_startTriangles,
+        .duplicates = g_dedup ? &resources.duplicates : nullptr,
+        .runSeed = g_runSeed,
+        .nrPrefetch = g_prefetch,
+    };
+    if (g_indirectDraws) {
+        info.drawBuffers[0] = &resources.drawBuffers[0];
+        info.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+
+    return batchCreate(ctx, info);
+}
+
+Dedup initDedup() {
+    DedupInfo info {
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .drawBuffers = { &resources.drawBuffers[0], &resources.drawBuffers[1] },
+        .parentBuffer = &resources.parentsBuffer,
+        .scoreBuffer = &resources.scoresBuffer,
+        .duplicates = &resources.duplicates,
+        .nrInstances = g_totalInstances,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+    };
+
+    return dedupCreate(ctx, info);
+}
+
+Refine initRefine() {
+    RefineInfo info {
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .scoreBuffer = &resources.scoresBuffer,
+        .goal = &resources.goal,
+        .nrInstances = g_totalInstances,
+        .nrInstancesPerGoal = g_totalInstances / g_nrGoals,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+        .instanceWidth = g_imageWidth,
+        .instanceHeight = g_imageHeight,
+        .steps = g_refineSteps,
+    };
+    if (g_indirectDraws) {
+        info.drawBuffers[0] = &resources.drawBuffers[0];
+        info.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+
+    return refineCreate(ctx, info);
+}
+
+Climb initClimb() {
+    ClimbInfo info {
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .scoreBuffer = &resources.scoresBuffer,
+        .goal = &resources.goal,
+        .nrInstances = g_totalInstances,
+        .nrInstancesPerGoal = g_totalInstances / g_nrGoals,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+        .instanceWidth = g_imageWidth,
+        .instanceHeight = g_imageHeight,
+        .nrCandidates = g_climbCandidates,
+    };
+
+    return climbCreate(ctx, info);
+}
+
+Plateau initPlateau() {
+    PlateauInfo info {
+        .scoreBuffer = &resources.scoresBuffer,
+        .nrInstances = g_totalInstances,
+        .nrInstancesPerGoal = g_totalInstances / g_nrGoals,
+        .pixelsPerInstance = g_imageWidth * g_imageHeight,
+        .targetFitness = g_targetFitness,
+        .window = g_plateauWindow,
+        .maxGenerations = g_maxGenerations,
+    };
+    if (!g_plateau) {
+        // only tracked, fitness stays below 2 and the counters do not get that far
+        info.targetFitness = 2.0f;
+        info.window = UINT32_MAX;
+        info.maxGenerations = UINT32_MAX;
+    }
+
+    return plateauCreate(ctx, info);
+}
+
+Overdraw initOverdraw() {
+    OverdrawInfo info {
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .nrInstances = g_totalInstances,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+        .instanceWidth = g_imageWidth,
+        .instanceHeight = g_imageHeight,
+    };
+    if (g_indirectDraws) {
+        info.drawBuffers[0] = &resources.drawBuffers[0];
+        info.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+
+    return overdrawCreate(ctx, info);
+}
+
+void logProfile(Ctx& ctx, const std::vector<ProfilerScope>& scopes, Overdraw& overdraw) {
+    profilerLog(scopes);
+    for (const auto& scope : scopes) {
+        if (strcmp(scope.name, "grid_render") == 0 && scope.fragmentInvocations > 0) {
+            const uint64_t pixels = uint64_t(g_totalInstances) * g_imageWidth * g_imageHeight;
+            logger::info("Profile grid_render: {:.2f} fragment invocations per pixel", scope.fragmentInvocations / double(pixels));
+        }
+    }
+
+    const uint32_t nrBins = g_trianglesPerInstance + 1;
+    auto histograms = overdrawHistograms(ctx, overdraw);
+    std::vector<uint64_t> total(nrBins, 0);
+    float worstMean = 0.0f;
+    uint32_t worstInstance = 0;
+    for (uint32_t instance=0; instance<g_totalInstances; instance++) {
+        std::vector<uint64_t> bins(histograms.begin() + instance * nrBins, histograms.begin() + (instance+1) * nrBins);
+        for (uint32_t i=0; i<nrBins; i++) {
+            total[i] += bins[i];
+        }
+        float mean = overdrawSummarize(bins).mean;
+        if (mean > worstMean) {
+            worstMean = mean;
+            worstInstance = instance;
+        }
+    }
+    auto summary = overdrawSummarize(total);
+    logger::info("Overdraw: {:.2f} triangles per pixel, median {}, p99 {}, max {}, worst instance {} at {:.2f}",
+            summary.mean, summary.median, summary.p99, summary.max, worstInstance, worstMean);
+}
+
+Cull initCull() {
+    CullInfo info {
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .culledVertices = &resources.culledVertices,
+        .culledDraws = &resources.culledDraws,
+        .nrInstances = g_totalInstances,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+        .instanceWidth = g_imageWidth,
+        .instanceHeight = g_imageHeight,
+    };
+    if (g_indirectDraws) {
+        info.drawBuffers[0] = &resources.drawBuffers[0];
+        info.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+
+    return cullCreate(ctx, info);
+}
+
+Control initControl() {
+    ControlInfo info {
+        .endpoint = *g_control,
+        .vertexBuffers = { &resources.vertexBuffers[0], &resources.vertexBuffers[1] },
+        .nrInstances = g_totalInstances,
+        .nrTrianglesPerInstance = g_trianglesPerInstance,
+    };
+    if (g_indirectDraws) {
+        info.drawBuffers[0] = &resources.drawBuffers[0];
+        info.drawBuffers[1] = &resources.drawBuffers[1];
+    }
+    if (g_meshVertices > 0) {
+        info.indexBuffers[0] = &resources.indexBuffers[0];
+        info.indexBuffers[1] = &resources.indexBuffers[1];
+        info.meshVertices = g_meshVertices;
+    }
+    // The batch picks its goals from the manifest
+    if (!g_batchManifest) {
+        info.goals = &resources.goal;
+    }
+
+    return controlCreate(ctx, info);
+}
+
+void applyControl(Ctx& ctx, std::vector<ControlCommand>& commands, LotteryArgs& lotteryArgs, EvolveArgs& evolveArgs,
+        Plateau* plateau, bool& paused, bool& regrade) {
+    for (auto& command : commands) {
+        switch (command.type) {
+        case CONTROL_SET:
+            if (command.name == "shift") {
+                lotteryArgs.shift = command.value;
+            } else if (command.name == "mutation-rate") {
+                evolveArgs.mutationRate = command.value;
+            } else if (command.name == "adapt-rate") {
+                evolveArgs.adaptRate = command.value;
+            } else if (command.name == "grow-rate") {
+                evolveArgs.growRate = command.value;
+            } else if (command.name == "shrink-rate") {
+                evolveArgs.shrinkRate = command.value;
+            } else if (command.name == "temperature") {
+                g_climbTemperature = command.value;
+            }
+            logger::info("Control: {} set to {}", command.name, command.value);
+            break;
+        case CONTROL_GOAL:
+            // The frame before is done, the grader and the climb read the new layer from this one on
+            uploadImageLayerD(ctx, resources.goal, command.layer, VK_IMAGE_LAYOUT_GENERAL, command.pixels.data());
+            if (plateau) {
+                plateauReset(ctx, *plateau, command.layer);
+            }
+            regrade = true;
+            logger::info("Control: goal {} is now {}", command.layer, command.name);
+            break;
+        case CONTROL_PAUSE:
+            paused = true;
+            logger::info("Control: paused");
+            break;
+        case CONTROL_RESUME:
+            paused = false;
+            logger::info("Control: resumed");
+            break;
+        }
+    }
+}